@@ -11,6 +11,20 @@
 
 // #define DEBUG_CELL_INFO
 
+// Collect unreachable quadtrees before every step, and log each collection
+// #define DEBUG_STRESS_GC
+// #define DEBUG_LOG_GC
+
+// Check the vector grid kernels against the scalar rules whenever they are selected
+// #define DEBUG_KERNELS
+
+// Check at startup that stepping the grid keeps painted cells to be drawn, and that sleeping chunks do not change where
+// fluid spreads to
+// #define DEBUG_GRID
+
+// Check the life engine against the plain rule at startup
+// #define DEBUG_LIFE
+
 #define IN_BBOX(vector, bbox)                                                                                          \
     (vector.x >= bbox.min.x && vector.y >= bbox.min.y && vector.x <= bbox.max.x && vector.y <= bbox.max.y)
 #define IN_RECT(vector, rect)                                                                                          \
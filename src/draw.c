@@ -8,13 +8,20 @@ void drawCenteredSquare(Vector2 pos, float width, Color color) {
     DrawRectangle(pos.x - width * 0.5, pos.y - width * 0.5, width, width, color);
 }
 
-// Draws a centred grid at `centre`.
-void drawGridUnderlay(Vector2 centre, int rows, int cols, float spacing) {
-    float width = cols * spacing;
-    float height = rows * spacing;
-    for (int i = 0; i < cols; i++) {
-        for (int j = 0; j < rows; j++) {
-            DrawRectangleLines(centre.x - width/2.0f + i*spacing, centre.y - height/2.0f + j * spacing, spacing, spacing, DARKGRAY);
+// Draws a centred grid at `centre`. Only the squares inside `view` are drawn, as the grid may be far larger than it.
+void drawGridUnderlay(Vector2 centre, int64_t rows, int64_t cols, float spacing, Rectangle view) {
+    float left = centre.x - cols * spacing / 2.0f;
+    float top = centre.y - rows * spacing / 2.0f;
+    int64_t colStart = view.x > left ? (int64_t)((view.x - left) / spacing) : 0;
+    int64_t rowStart = view.y > top ? (int64_t)((view.y - top) / spacing) : 0;
+    int64_t colEnd = (int64_t)((view.x + view.width - left) / spacing) + 1;
+    int64_t rowEnd = (int64_t)((view.y + view.height - top) / spacing) + 1;
+    colEnd = colEnd < cols ? colEnd : cols;
+    rowEnd = rowEnd < rows ? rowEnd : rows;
+
+    for (int64_t i = colStart; i < colEnd; i++) {
+        for (int64_t j = rowStart; j < rowEnd; j++) {
+            DrawRectangleLines(left + i * spacing, top + j * spacing, spacing, spacing, DARKGRAY);
         }
     }
 }
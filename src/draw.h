@@ -2,9 +2,10 @@
 #define ptest_draw_h
 
 #include "raylib.h"
+#include <stdint.h>
 
 void drawCenteredSquareLines(Vector2 pos, float width, Color color);
 void drawCenteredSquare(Vector2 pos, float width, Color color);
-void drawGridUnderlay(Vector2 centre, int rows, int cols, float spacing);
+void drawGridUnderlay(Vector2 centre, int64_t rows, int64_t cols, float spacing, Rectangle view);
 
 #endif // ptest_draw_h
@@ -4,14 +4,90 @@
 #include "value.h"
 #include <stdint.h>
 
+// Number of ghost cells surrounding the grid on each side. Ghost cells hold the boundary material so that
+// neighbourhoods at the edge of the grid are still backed by memory, and can be read without bounds checks.
+#define GRID_HALO 1
+
+// The grid is split into square chunks of this many cells a side. Only chunks that changed, and their neighbours, are
+// evolved, so the cost of a step follows the amount of activity rather than the area of the grid.
+#define GRID_CHUNK_SIZE 64
+
+// Set on a chunk when any of its cells differ from the grid it was evolved from, or were painted since.
+#define CHUNK_CHANGED 0x01
+// Set on a chunk holding cells painted since it was last drawn. A step may leave painted cells alone, so this is carried
+// into the result of every step until the chunk is drawn.
+#define CHUNK_PAINTED 0x02
+
+// A chunk is in equilibrium once it has gone this many steps in a row with none of it falling, and every cell the same
+// kind as two steps before with its state within EQUILIBRIUM_DRIFT of what it was then. Still water never quite stops,
+// it sloshes back and forth between neighbouring cells, so each cell is compared with two steps before rather than with
+// the step before. Comparing cells rather than the whole chunk keeps fluid spreading within the chunk awake. A spreading
+// puddle only moves a unit of state at a time at its edges, so any drift at all lets it fall asleep before it is done.
+#define EQUILIBRIUM_STEPS 32
+#define EQUILIBRIUM_DRIFT 0
+
+// A growable list of cells, as indices relative to `cells` of a grid.
+typedef struct CellList {
+    int *cells;
+    int count;
+    int capacity;
+} CellList;
+
+// What lies beyond the edge of the grid, which is what the halo holds.
+typedef enum {
+    BOUNDARY_WALL, // Solid stone, which fluid piles up against.
+    BOUNDARY_SINK, // Vacuum, which fluid flows out into and is lost.
+    BOUNDARY_WRAP, // The other side of the grid, so the grid is a torus.
+} GridBoundary;
+
+// Cells are stored in a single contiguous, cache line aligned block. Each row is `stride` cells long, which includes
+// the halo on both sides and any padding needed to keep rows aligned.
 typedef struct Grid {
-    CellValue **cells;
+    CellValue *data;  // Start of the allocation, including the halo.
+    CellValue *cells; // The cell at row 0, col 0.
     int rows;
     int cols;
+    int stride;
+    GridBoundary boundary;
+    int chunkRows;
+    int chunkCols;
+    uint8_t *chunks; // Flags of each chunk, row major.
+    uint8_t *quiet;  // Steps in a row each chunk has been in equilibrium, up to EQUILIBRIUM_STEPS.
+    MaterialSet *materials; // Materials in each chunk. May hold some that have since left, but never misses one.
+    CellList changed; // Cells that differ from the grid this was evolved from, or were painted since. A count of -1
+                      // means they are not known, and the next step sweeps the awake chunks instead.
 } Grid;
 
+// Index of the cell at `row` and `col` relative to `cells`. Valid for -GRID_HALO <= row < rows + GRID_HALO, and
+// similarly for col.
+#define GRID_INDEX(grid, row, col) ((row) * (grid)->stride + (col))
+#define GRID_CELL(grid, row, col) ((grid)->cells[GRID_INDEX(grid, row, col)])
+#define GRID_CHUNK(grid, chunkRow, chunkCol) ((grid)->chunks[(chunkRow) * (grid)->chunkCols + (chunkCol)])
+
+// Reads `count` cells of `row`, starting at `col`, from `source` into `cells`. The cells may be anywhere, including
+// beyond the edge of what `source` holds.
+typedef void (*CellReader)(const void *source, int row, int col, int count, CellValue *cells);
+
+// Somewhere `advanceBlock` reads cells from. Only cells in rows [top, bottom) and cols [left, right) are evolved, the
+// cells beyond are a boundary that never changes.
+typedef struct CellSource {
+    CellReader read;
+    const void *data;
+    int top;
+    int bottom;
+    int left;
+    int right;
+} CellSource;
+
+typedef enum {
+    BLOCK_SKIPPED, // There is no fluid near the block, so it cannot have changed and nothing was written.
+    BLOCK_SETTLED, // The block was written, and is the same as the source.
+    BLOCK_CHANGED, // The block was written, and differs from the source or changed in the last generation.
+} BlockResult;
+
 void initGrid(Grid *grid, uint16_t rows, uint16_t cols);
 void freeGrid(Grid *grid);
+void setGridBoundary(Grid *grid, GridBoundary boundary);
 
 void drawGridPixels(const Grid *grid, int x, int y);
 
@@ -20,6 +96,13 @@ int gridDrawHeight(int scale, Grid grid);
 void drawGrid(const Grid *grid, int x, int y, int cellWidth, int cellHeight, int spacing);
 
 bool getCellAt(const Grid *grid, int grid_x, int grid_y, float x, float y, int cellWidth, int cellHeight, CellValue **result);
+void markCellChanged(Grid *grid, const CellValue *cell);
 void evolveGrid(const Grid *grid, Grid *result);
+void advanceGrid(const Grid *grid, Grid *result, int generations);
+bool checkGrid();
+
+void prepareBlocks(int rows, int cols, int generations);
+BlockResult advanceBlock(CellSource source, int row, int col, int rows, int cols, int generations, int worker,
+                         CellValue *cells, int stride);
 
 #endif // ptest_grid_h
@@ -16,3 +16,19 @@ int hash_6432shift(long key) {
 int hash_uintptr_t(uintptr_t ptr) { return hash_6432shift(ptr); }
 
 int hash_ptr(void *ptr) { return hash_uintptr_t((uintptr_t)ptr); }
+
+// The splitmix64 finalizer. Every bit of `key` affects every bit of the result, so keys that differ in a few low bits,
+// like pointers to neighbouring allocations, still land far apart.
+uint64_t hash_mix64(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebull;
+    key ^= key >> 31;
+    return key;
+}
+
+// Folds `value` into the hash `seed`. The order values are folded in matters, so swapping two of them changes the hash.
+uint64_t hash_combine64(uint64_t seed, uint64_t value) {
+    return hash_mix64(seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2)));
+}
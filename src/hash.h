@@ -7,4 +7,7 @@ int hash_6432shift(long key);
 int hash_uintptr_t(uintptr_t ptr);
 int hash_ptr(void *ptr);
 
+uint64_t hash_mix64(uint64_t key);
+uint64_t hash_combine64(uint64_t seed, uint64_t value);
+
 #endif // ptest_hash_h
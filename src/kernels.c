@@ -0,0 +1,486 @@
+#include "kernels.h"
+#include "common.h"
+#include "debug.h"
+#include "material.h"
+#include "memory.h"
+#include "neighbourhood.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+void storeOccupation(OccupationPlanes occ, int index, OccupationNumber value) {
+    occ.nw[index] = value.nw;
+    occ.n[index] = value.n;
+    occ.ne[index] = value.ne;
+    occ.w[index] = value.w;
+    occ.c[index] = value.c;
+    occ.e[index] = value.e;
+    occ.sw[index] = value.sw;
+    occ.s[index] = value.s;
+    occ.se[index] = value.se;
+}
+
+static OccupationNumber loadOccupation(OccupationPlanes occ, int index) {
+    return (OccupationNumber){occ.nw[index], occ.n[index],  occ.ne[index], occ.w[index], occ.c[index],
+                              occ.e[index],  occ.sw[index], occ.s[index],  occ.se[index]};
+}
+
+// Returns the occupation flowing into the cell at `index` from each of its neighbours. For example `nw` is the south
+// east component of the north west neighbour.
+OccupationNumber inflowAt(OccupationPlanes occ, int stride, int index) {
+    return (OccupationNumber){// clang-format off
+        .nw = occ.se[index - stride - 1],
+        .n = occ.s[index - stride],
+        .ne = occ.sw[index - stride + 1],
+        .w = occ.e[index - 1],
+        .c = occ.c[index],
+        .e = occ.w[index + 1],
+        .sw = occ.ne[index + stride - 1],
+        .s = occ.n[index + stride],
+        .se = occ.nw[index + stride + 1]
+    }; // clang-format on
+}
+
+// Scalar kernels. These apply the rules in neighbourhood.c directly, and are what the vector kernels must match.
+
+static void collideScalar(const CellValue *cells, int stride, int index, int count, OccupationPlanes occ) {
+    const MaterialTables *tables = getMaterials();
+    for (int i = index; i < index + count; i++) {
+        OccupationNumber value;
+        if (isFluid(cells[i])) {
+            // collide only reads the neighbourhood
+            CellValue *c = (CellValue *)&cells[i];
+            CellNeighbourhood n = newCellNeighbourhood(c - stride - 1, c - stride, c - stride + 1, c - 1, c, c + 1,
+                                                       c + stride - 1, c + stride, c + stride + 1);
+            value = collide(tables, n);
+        } else {
+            initOccupationNumber(&value);
+        }
+        storeOccupation(occ, i, value);
+    }
+}
+
+static void gatherScalar(OccupationPlanes occ, int stride, int index, int count, int16_t *sums) {
+    for (int k = 0; k < count; k++) {
+        sums[k] = (int16_t)surroundingSum(inflowAt(occ, stride, index + k));
+    }
+}
+
+#ifdef KERNELS_X86
+
+// Vector kernels. Each lane of the collide kernels is one cell, which as a 32-bit word is laid out as
+// [kind | flags | state], so the type, material and state can be pulled out with shifts and masks. How each material
+// behaves is looked up from the byte tables in `MaterialTables`, which fit in a register, by shuffling with the material
+// of each lane. The gather kernels add 16-bit lanes, which wrap the same way the scalar sum does once stored in a cell.
+
+#define FLUID_TYPE (FLUID << CELL_TYPE_SHIFT)
+
+#define SSE_TARGET __attribute__((target("sse4.1")))
+
+SSE_TARGET static __m128i typeOf128(__m128i cells) { return _mm_and_si128(cells, _mm_set1_epi32(0xF0)); }
+SSE_TARGET static __m128i materialOf128(__m128i cells) { return _mm_and_si128(cells, _mm_set1_epi32(0x0F)); }
+SSE_TARGET static __m128i stateOf128(__m128i cells) { return _mm_srli_epi32(cells, 16); }
+
+// Looks up the entry of a 16 byte `table` for the material of each lane. Setting the top bit of the other bytes of the
+// shuffle index zeroes them.
+SSE_TARGET static __m128i lookup128(__m128i table, __m128i material) {
+    return _mm_shuffle_epi8(table, _mm_or_si128(material, _mm_set1_epi32((int)0x80808000)));
+}
+
+// Lanes where `destination` could take fluid from the centre. Empty destinations always can, while fluid ones must be
+// the same material and below `limit`.
+SSE_TARGET static __m128i accepts128(__m128i canFlow, __m128i material, __m128i destination, __m128i limit) {
+    __m128i type = typeOf128(destination);
+    __m128i empty = _mm_cmpeq_epi32(type, _mm_setzero_si128());
+    __m128i fluid = _mm_and_si128(_mm_cmpeq_epi32(type, _mm_set1_epi32(FLUID_TYPE)),
+                                  _mm_cmpeq_epi32(materialOf128(destination), material));
+    fluid = _mm_and_si128(fluid, _mm_cmpgt_epi32(limit, stateOf128(destination)));
+    return _mm_and_si128(canFlow, _mm_or_si128(empty, fluid));
+}
+
+SSE_TARGET static __m128i canFlow128(__m128i isFluid, __m128i state) {
+    return _mm_and_si128(isFluid, _mm_cmpgt_epi32(state, _mm_setzero_si128()));
+}
+
+SSE_TARGET static void store128(int16_t *plane, __m128i value) {
+    _mm_storel_epi64((__m128i *)plane, _mm_packs_epi32(value, value));
+}
+
+SSE_TARGET static void collideSSE(const CellValue *cells, int stride, int index, int count, OccupationPlanes occ) {
+    const MaterialTables *tables = getMaterials();
+    const __m128i maxStates = _mm_loadu_si128((const __m128i *)tables->maxState);
+    const __m128i flowRates = _mm_loadu_si128((const __m128i *)tables->flowRate);
+    const __m128i zero = _mm_setzero_si128();
+
+    int i = index;
+    for (; i + 4 <= index + count; i += 4) {
+        __m128i c = _mm_loadu_si128((const __m128i *)&cells[i]);
+        __m128i isFluid = _mm_cmpeq_epi32(typeOf128(c), _mm_set1_epi32(FLUID_TYPE));
+        __m128i material = materialOf128(c);
+        __m128i state = stateOf128(c);
+        __m128i occC = _mm_and_si128(isFluid, state);
+        __m128i maxState = lookup128(maxStates, material);
+        __m128i maxFlow = lookup128(flowRates, material);
+
+        // Falling south
+        __m128i d = _mm_loadu_si128((const __m128i *)&cells[i + stride]);
+        __m128i dState = stateOf128(d);
+        __m128i mask = accepts128(canFlow128(isFluid, state), material, d, maxState);
+        __m128i limit = _mm_min_epi32(_mm_sub_epi32(maxState, dState), state);
+        __m128i occS = _mm_and_si128(mask, _mm_min_epi32(_mm_abs_epi32(_mm_sub_epi32(state, dState)), limit));
+        occC = _mm_sub_epi32(occC, occS);
+        state = _mm_sub_epi32(state, occS);
+
+        // Falling south west
+        d = _mm_loadu_si128((const __m128i *)&cells[i + stride - 1]);
+        dState = stateOf128(d);
+        mask = accepts128(canFlow128(isFluid, state), material, d, maxState);
+        limit = _mm_min_epi32(_mm_sub_epi32(maxState, dState), state);
+        __m128i occSW = _mm_and_si128(mask, _mm_min_epi32(_mm_abs_epi32(_mm_sub_epi32(state, dState)), limit));
+        occC = _mm_sub_epi32(occC, occSW);
+        state = _mm_sub_epi32(state, occSW);
+
+        // Falling south east. The scalar rule bounds this by the south west flow.
+        d = _mm_loadu_si128((const __m128i *)&cells[i + stride + 1]);
+        dState = stateOf128(d);
+        mask = accepts128(canFlow128(isFluid, state), material, d, maxState);
+        limit = _mm_min_epi32(_mm_sub_epi32(maxState, dState), state);
+        __m128i occSE = _mm_and_si128(mask, _mm_min_epi32(occSW, limit));
+        occC = _mm_sub_epi32(occC, occSE);
+        state = _mm_sub_epi32(state, occSE);
+
+        // Spreading west. Half the difference, rounded towards zero.
+        d = _mm_loadu_si128((const __m128i *)&cells[i - 1]);
+        dState = stateOf128(d);
+        mask = accepts128(canFlow128(isFluid, state), material, d, state);
+        __m128i diff = _mm_sub_epi32(state, dState);
+        __m128i half = _mm_srai_epi32(_mm_add_epi32(diff, _mm_srli_epi32(diff, 31)), 1);
+        __m128i occW = _mm_and_si128(mask, _mm_min_epi32(half, maxFlow));
+        occC = _mm_sub_epi32(occC, occW);
+        state = _mm_sub_epi32(state, occW);
+
+        // Spreading east
+        d = _mm_loadu_si128((const __m128i *)&cells[i + 1]);
+        dState = stateOf128(d);
+        mask = accepts128(canFlow128(isFluid, state), material, d, state);
+        diff = _mm_sub_epi32(state, dState);
+        half = _mm_srai_epi32(_mm_add_epi32(diff, _mm_srli_epi32(diff, 31)), 1);
+        __m128i occE = _mm_and_si128(mask, _mm_min_epi32(half, maxFlow));
+        occC = _mm_sub_epi32(occC, occE);
+        state = _mm_sub_epi32(state, occE);
+
+        // Pressure pushing north
+        d = _mm_loadu_si128((const __m128i *)&cells[i - stride]);
+        mask = accepts128(canFlow128(isFluid, state), material, d, state);
+        mask = _mm_and_si128(mask, _mm_cmpgt_epi32(state, maxState));
+        __m128i occN = _mm_and_si128(mask, _mm_sub_epi32(state, maxState));
+        occC = _mm_sub_epi32(occC, occN);
+
+        store128(&occ.nw[i], zero);
+        store128(&occ.n[i], occN);
+        store128(&occ.ne[i], zero);
+        store128(&occ.w[i], occW);
+        store128(&occ.c[i], occC);
+        store128(&occ.e[i], occE);
+        store128(&occ.sw[i], occSW);
+        store128(&occ.s[i], occS);
+        store128(&occ.se[i], occSE);
+    }
+
+    collideScalar(cells, stride, i, index + count - i, occ);
+}
+
+#define LOAD128(plane, offset) _mm_loadu_si128((const __m128i *)&(plane)[i + (offset)])
+
+SSE_TARGET static void gatherSSE(OccupationPlanes occ, int stride, int index, int count, int16_t *sums) {
+    int k = 0;
+    for (; k + 8 <= count; k += 8) {
+        int i = index + k;
+        __m128i sum = _mm_add_epi16(LOAD128(occ.se, -stride - 1), LOAD128(occ.s, -stride));
+        sum = _mm_add_epi16(sum, LOAD128(occ.sw, -stride + 1));
+        sum = _mm_add_epi16(sum, LOAD128(occ.e, -1));
+        sum = _mm_add_epi16(sum, LOAD128(occ.c, 0));
+        sum = _mm_add_epi16(sum, LOAD128(occ.w, 1));
+        sum = _mm_add_epi16(sum, LOAD128(occ.ne, stride - 1));
+        sum = _mm_add_epi16(sum, LOAD128(occ.n, stride));
+        sum = _mm_add_epi16(sum, LOAD128(occ.nw, stride + 1));
+        _mm_storeu_si128((__m128i *)&sums[k], sum);
+    }
+
+    gatherScalar(occ, stride, index + k, count - k, sums + k);
+}
+
+#undef LOAD128
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET static __m256i typeOf256(__m256i cells) { return _mm256_and_si256(cells, _mm256_set1_epi32(0xF0)); }
+AVX2_TARGET static __m256i materialOf256(__m256i cells) { return _mm256_and_si256(cells, _mm256_set1_epi32(0x0F)); }
+AVX2_TARGET static __m256i stateOf256(__m256i cells) { return _mm256_srli_epi32(cells, 16); }
+
+// As `lookup128`. The shuffle works within each 128-bit half, so `table` must hold the 16 bytes in both halves.
+AVX2_TARGET static __m256i lookup256(__m256i table, __m256i material) {
+    return _mm256_shuffle_epi8(table, _mm256_or_si256(material, _mm256_set1_epi32((int)0x80808000)));
+}
+
+AVX2_TARGET static __m256i accepts256(__m256i canFlow, __m256i material, __m256i destination, __m256i limit) {
+    __m256i type = typeOf256(destination);
+    __m256i empty = _mm256_cmpeq_epi32(type, _mm256_setzero_si256());
+    __m256i fluid = _mm256_and_si256(_mm256_cmpeq_epi32(type, _mm256_set1_epi32(FLUID_TYPE)),
+                                     _mm256_cmpeq_epi32(materialOf256(destination), material));
+    fluid = _mm256_and_si256(fluid, _mm256_cmpgt_epi32(limit, stateOf256(destination)));
+    return _mm256_and_si256(canFlow, _mm256_or_si256(empty, fluid));
+}
+
+AVX2_TARGET static __m256i canFlow256(__m256i isFluid, __m256i state) {
+    return _mm256_and_si256(isFluid, _mm256_cmpgt_epi32(state, _mm256_setzero_si256()));
+}
+
+// Narrows eight 32-bit lanes to 16 bits. `packs` works within each 128-bit half, so gather the two halves back
+// together before storing.
+AVX2_TARGET static void store256(int16_t *plane, __m256i value) {
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(value, value), 0x08);
+    _mm_storeu_si128((__m128i *)plane, _mm256_castsi256_si128(packed));
+}
+
+AVX2_TARGET static void collideAVX2(const CellValue *cells, int stride, int index, int count, OccupationPlanes occ) {
+    const MaterialTables *tables = getMaterials();
+    const __m256i maxStates = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tables->maxState));
+    const __m256i flowRates = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tables->flowRate));
+    const __m256i zero = _mm256_setzero_si256();
+
+    int i = index;
+    for (; i + 8 <= index + count; i += 8) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)&cells[i]);
+        __m256i isFluid = _mm256_cmpeq_epi32(typeOf256(c), _mm256_set1_epi32(FLUID_TYPE));
+        __m256i material = materialOf256(c);
+        __m256i state = stateOf256(c);
+        __m256i occC = _mm256_and_si256(isFluid, state);
+        __m256i maxState = lookup256(maxStates, material);
+        __m256i maxFlow = lookup256(flowRates, material);
+
+        // Falling south
+        __m256i d = _mm256_loadu_si256((const __m256i *)&cells[i + stride]);
+        __m256i dState = stateOf256(d);
+        __m256i mask = accepts256(canFlow256(isFluid, state), material, d, maxState);
+        __m256i limit = _mm256_min_epi32(_mm256_sub_epi32(maxState, dState), state);
+        __m256i occS =
+            _mm256_and_si256(mask, _mm256_min_epi32(_mm256_abs_epi32(_mm256_sub_epi32(state, dState)), limit));
+        occC = _mm256_sub_epi32(occC, occS);
+        state = _mm256_sub_epi32(state, occS);
+
+        // Falling south west
+        d = _mm256_loadu_si256((const __m256i *)&cells[i + stride - 1]);
+        dState = stateOf256(d);
+        mask = accepts256(canFlow256(isFluid, state), material, d, maxState);
+        limit = _mm256_min_epi32(_mm256_sub_epi32(maxState, dState), state);
+        __m256i occSW =
+            _mm256_and_si256(mask, _mm256_min_epi32(_mm256_abs_epi32(_mm256_sub_epi32(state, dState)), limit));
+        occC = _mm256_sub_epi32(occC, occSW);
+        state = _mm256_sub_epi32(state, occSW);
+
+        // Falling south east. The scalar rule bounds this by the south west flow.
+        d = _mm256_loadu_si256((const __m256i *)&cells[i + stride + 1]);
+        dState = stateOf256(d);
+        mask = accepts256(canFlow256(isFluid, state), material, d, maxState);
+        limit = _mm256_min_epi32(_mm256_sub_epi32(maxState, dState), state);
+        __m256i occSE = _mm256_and_si256(mask, _mm256_min_epi32(occSW, limit));
+        occC = _mm256_sub_epi32(occC, occSE);
+        state = _mm256_sub_epi32(state, occSE);
+
+        // Spreading west. Half the difference, rounded towards zero.
+        d = _mm256_loadu_si256((const __m256i *)&cells[i - 1]);
+        dState = stateOf256(d);
+        mask = accepts256(canFlow256(isFluid, state), material, d, state);
+        __m256i diff = _mm256_sub_epi32(state, dState);
+        __m256i half = _mm256_srai_epi32(_mm256_add_epi32(diff, _mm256_srli_epi32(diff, 31)), 1);
+        __m256i occW = _mm256_and_si256(mask, _mm256_min_epi32(half, maxFlow));
+        occC = _mm256_sub_epi32(occC, occW);
+        state = _mm256_sub_epi32(state, occW);
+
+        // Spreading east
+        d = _mm256_loadu_si256((const __m256i *)&cells[i + 1]);
+        dState = stateOf256(d);
+        mask = accepts256(canFlow256(isFluid, state), material, d, state);
+        diff = _mm256_sub_epi32(state, dState);
+        half = _mm256_srai_epi32(_mm256_add_epi32(diff, _mm256_srli_epi32(diff, 31)), 1);
+        __m256i occE = _mm256_and_si256(mask, _mm256_min_epi32(half, maxFlow));
+        occC = _mm256_sub_epi32(occC, occE);
+        state = _mm256_sub_epi32(state, occE);
+
+        // Pressure pushing north
+        d = _mm256_loadu_si256((const __m256i *)&cells[i - stride]);
+        mask = accepts256(canFlow256(isFluid, state), material, d, state);
+        mask = _mm256_and_si256(mask, _mm256_cmpgt_epi32(state, maxState));
+        __m256i occN = _mm256_and_si256(mask, _mm256_sub_epi32(state, maxState));
+        occC = _mm256_sub_epi32(occC, occN);
+
+        store256(&occ.nw[i], zero);
+        store256(&occ.n[i], occN);
+        store256(&occ.ne[i], zero);
+        store256(&occ.w[i], occW);
+        store256(&occ.c[i], occC);
+        store256(&occ.e[i], occE);
+        store256(&occ.sw[i], occSW);
+        store256(&occ.s[i], occS);
+        store256(&occ.se[i], occSE);
+    }
+
+    collideScalar(cells, stride, i, index + count - i, occ);
+}
+
+#define LOAD256(plane, offset) _mm256_loadu_si256((const __m256i *)&(plane)[i + (offset)])
+
+AVX2_TARGET static void gatherAVX2(OccupationPlanes occ, int stride, int index, int count, int16_t *sums) {
+    int k = 0;
+    for (; k + 16 <= count; k += 16) {
+        int i = index + k;
+        __m256i sum = _mm256_add_epi16(LOAD256(occ.se, -stride - 1), LOAD256(occ.s, -stride));
+        sum = _mm256_add_epi16(sum, LOAD256(occ.sw, -stride + 1));
+        sum = _mm256_add_epi16(sum, LOAD256(occ.e, -1));
+        sum = _mm256_add_epi16(sum, LOAD256(occ.c, 0));
+        sum = _mm256_add_epi16(sum, LOAD256(occ.w, 1));
+        sum = _mm256_add_epi16(sum, LOAD256(occ.ne, stride - 1));
+        sum = _mm256_add_epi16(sum, LOAD256(occ.n, stride));
+        sum = _mm256_add_epi16(sum, LOAD256(occ.nw, stride + 1));
+        _mm256_storeu_si256((__m256i *)&sums[k], sum);
+    }
+
+    gatherSSE(occ, stride, index + k, count - k, sums + k);
+}
+
+#undef LOAD256
+
+#endif // KERNELS_X86
+
+static const Kernels kernelTable[] = {
+    [KERNELS_SCALAR] = {KERNELS_SCALAR, "scalar", collideScalar, gatherScalar},
+#ifdef KERNELS_X86
+    [KERNELS_SSE] = {KERNELS_SSE, "sse4.1", collideSSE, gatherSSE},
+    [KERNELS_AVX2] = {KERNELS_AVX2, "avx2", collideAVX2, gatherAVX2},
+#endif
+};
+
+static const Kernels *active = NULL;
+
+// Returns the best kernels this CPU supports.
+KernelLevel maxKernelLevel() {
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return KERNELS_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return KERNELS_SSE;
+    }
+#endif
+    return KERNELS_SCALAR;
+}
+
+// Selects the kernels to step with. Levels the CPU does not support fall back to the best one it does.
+KernelLevel setKernelLevel(KernelLevel level) {
+    KernelLevel max = maxKernelLevel();
+    active = &kernelTable[level > max ? max : level];
+
+#ifdef DEBUG_KERNELS
+    checkKernels();
+#endif
+
+    return active->level;
+}
+
+// Returns the selected kernels, picking the best supported the first time. Must first be called from a single thread.
+const Kernels *getKernels() {
+    if (active == NULL) {
+        setKernelLevel(KERNELS_AVX2);
+        LogMessage(LOG_INFO, "Using %s grid kernels", active->name);
+    }
+    return active;
+}
+
+// Conformance check of the selected kernels against the scalar rules, over a small grid holding every pairing of
+// cell kinds and a spread of states. Returns `false` and logs the first difference if they disagree.
+bool checkKernels() {
+#define CHECK_ROWS 16
+#define CHECK_COLS 75 // Not a multiple of any vector width, so the scalar tails are covered too
+#define CHECK_STRIDE (CHECK_COLS + 2)
+#define CHECK_SIZE (CHECK_STRIDE * (CHECK_ROWS + 2))
+
+    static const uint8_t kinds[] = {
+        CELL_KIND(VACUUM, NONE), CELL_KIND(FLUID, WATER), CELL_KIND(FLUID, WATER), CELL_KIND(FLUID, WATER),
+        CELL_KIND(FLUID, LAVA),  CELL_KIND(SOLID, STONE), CELL_KIND(FLUID, WATER), CELL_KIND(VACUUM, NONE),
+    };
+    static const uint16_t states[] = {0, 1, 2, 3, 5, 17, 31, 32, 33, 63, 64, 65, 66, 80, 127, 200, 511};
+
+    const Kernels *kernels = active != NULL ? active : &kernelTable[KERNELS_SCALAR];
+    const Kernels *scalar = &kernelTable[KERNELS_SCALAR];
+
+    CellValue *cells = ALLOCATE(CellValue, CHECK_SIZE);
+    int16_t *planes = ALLOCATE(int16_t, 2 * 9 * CHECK_SIZE);
+    int16_t *sums = ALLOCATE(int16_t, 2 * CHECK_COLS);
+    memset(planes, 0, sizeof(int16_t) * 2 * 9 * CHECK_SIZE);
+
+    OccupationPlanes occ[2];
+    for (int k = 0; k < 2; k++) {
+        int16_t *base = planes + k * 9 * CHECK_SIZE + CHECK_STRIDE + 1;
+        occ[k] = (OccupationPlanes){base,
+                                    base + CHECK_SIZE,
+                                    base + 2 * CHECK_SIZE,
+                                    base + 3 * CHECK_SIZE,
+                                    base + 4 * CHECK_SIZE,
+                                    base + 5 * CHECK_SIZE,
+                                    base + 6 * CHECK_SIZE,
+                                    base + 7 * CHECK_SIZE,
+                                    base + 8 * CHECK_SIZE};
+    }
+
+    unsigned int seed = 1;
+    for (int i = 0; i < CHECK_SIZE; i++) {
+        seed = seed * 1103515245 + 12345;
+        uint8_t kind = kinds[(seed >> 16) % (sizeof(kinds) / sizeof(kinds[0]))];
+        uint16_t state = states[(seed >> 8) % (sizeof(states) / sizeof(states[0]))];
+        cells[i] = (CellValue){kind, 0, kind == CELL_KIND(VACUUM, NONE) && (seed & 0x80) == 0 ? 0 : state};
+    }
+
+    const CellValue *origin = cells + CHECK_STRIDE + 1;
+    bool ok = true;
+    for (int row = 0; row < CHECK_ROWS && ok; row++) {
+        int index = row * CHECK_STRIDE;
+        scalar->collide(origin, CHECK_STRIDE, index, CHECK_COLS, occ[0]);
+        kernels->collide(origin, CHECK_STRIDE, index, CHECK_COLS, occ[1]);
+        for (int col = 0; col < CHECK_COLS && ok; col++) {
+            int i = index + col;
+            OccupationNumber want = loadOccupation(occ[0], i);
+            OccupationNumber got = loadOccupation(occ[1], i);
+            if (memcmp(&want, &got, sizeof(OccupationNumber)) != 0) {
+                LogMessage(LOG_ERROR, "%s collide differs from scalar at (%d, %d)", kernels->name, row, col);
+                ok = false;
+            }
+        }
+    }
+
+    for (int row = 0; row < CHECK_ROWS && ok; row++) {
+        int index = row * CHECK_STRIDE;
+        scalar->gather(occ[0], CHECK_STRIDE, index, CHECK_COLS, sums);
+        kernels->gather(occ[0], CHECK_STRIDE, index, CHECK_COLS, sums + CHECK_COLS);
+        if (memcmp(sums, sums + CHECK_COLS, sizeof(int16_t) * CHECK_COLS) != 0) {
+            LogMessage(LOG_ERROR, "%s gather differs from scalar on row %d", kernels->name, row);
+            ok = false;
+        }
+    }
+
+    FREE_ARRAY(CellValue, cells, CHECK_SIZE);
+    FREE_ARRAY(int16_t, planes, 2 * 9 * CHECK_SIZE);
+    FREE_ARRAY(int16_t, sums, 2 * CHECK_COLS);
+
+    return ok;
+
+#undef CHECK_ROWS
+#undef CHECK_COLS
+#undef CHECK_STRIDE
+#undef CHECK_SIZE
+}
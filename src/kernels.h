@@ -0,0 +1,50 @@
+#ifndef ptest_kernels_h
+#define ptest_kernels_h
+
+#include "value.h"
+
+// Occupation numbers stored as a structure of arrays. Every plane mirrors the layout of the grid being evolved, and
+// points at the entry for row 0, col 0, so the occupation of a cell shares its index.
+typedef struct OccupationPlanes {
+    int16_t *nw;
+    int16_t *n;
+    int16_t *ne;
+    int16_t *w;
+    int16_t *c;
+    int16_t *e;
+    int16_t *sw;
+    int16_t *s;
+    int16_t *se;
+} OccupationPlanes;
+
+// Collides the `count` cells starting at `cells[index]` into the planes. Non-fluid cells get an empty occupation. The
+// neighbours of every cell must be backed by memory, which the grid halo guarantees.
+typedef void (*CollideKernel)(const CellValue *cells, int stride, int index, int count, OccupationPlanes occ);
+
+// Sums the occupation flowing into each of the `count` cells starting at `index`, storing them in `sums`. The sums wrap
+// exactly like assigning the `int` from `surroundingSum` to a cell state does. Each plane is only read from one row, so
+// with a `stride` of 0 the planes may each point at a different row.
+typedef void (*GatherKernel)(OccupationPlanes occ, int stride, int index, int count, int16_t *sums);
+
+typedef enum {
+    KERNELS_SCALAR,
+    KERNELS_SSE,
+    KERNELS_AVX2,
+} KernelLevel;
+
+typedef struct Kernels {
+    KernelLevel level;
+    const char *name;
+    CollideKernel collide;
+    GatherKernel gather;
+} Kernels;
+
+const Kernels *getKernels();
+KernelLevel setKernelLevel(KernelLevel level);
+KernelLevel maxKernelLevel();
+bool checkKernels();
+
+void storeOccupation(OccupationPlanes occ, int index, OccupationNumber value);
+OccupationNumber inflowAt(OccupationPlanes occ, int stride, int index);
+
+#endif // ptest_kernels_h
@@ -0,0 +1,365 @@
+#include "life.h"
+#include "debug.h"
+#include "memory.h"
+#include "workers.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define LIFE_MAX_NEIGHBOURS 8
+
+// Reads the digits of one half of a rule into `counts`, stopping at the end of the string or a '/'.
+static bool parseCounts(const char **text, uint16_t *counts) {
+    *counts = 0;
+    while (**text != '\0' && **text != '/') {
+        int count = **text - '0';
+        if (count < 0 || count > LIFE_MAX_NEIGHBOURS) {
+            return false;
+        }
+        *counts |= 1u << count;
+        (*text)++;
+    }
+    return true;
+}
+
+// Parses a rule in B/S notation like "B3/S23", or the older S/B notation like "23/3".
+bool parseLifeRule(const char *text, LifeRule *rule) {
+    const char *cursor = text;
+    LifeRule parsed = {0, 0};
+    bool valid = true;
+
+    if (*cursor == 'B' || *cursor == 'b') {
+        cursor++;
+        valid = parseCounts(&cursor, &parsed.birth);
+        if (valid && *cursor == '/') {
+            cursor++;
+            valid = (*cursor == 'S' || *cursor == 's');
+            cursor++;
+            valid = valid && parseCounts(&cursor, &parsed.survival);
+        }
+    } else {
+        valid = parseCounts(&cursor, &parsed.survival);
+        if (valid && *cursor == '/') {
+            cursor++;
+            valid = parseCounts(&cursor, &parsed.birth);
+        }
+    }
+
+    if (!valid || *cursor != '\0') {
+        LogMessage(LOG_WARNING, "Invalid life rule %s", text);
+        return false;
+    }
+    *rule = parsed;
+    return true;
+}
+
+void initLifeGrid(LifeGrid *grid, int rows, int cols, bool wraps) {
+    grid->rows = rows;
+    grid->cols = cols;
+    grid->rowWords = (cols + LIFE_WORD_BITS - 1) / LIFE_WORD_BITS;
+    grid->stride = grid->rowWords + 2;
+    grid->wraps = wraps;
+    grid->data = ALLOCATE_ALIGNED(uint64_t, (size_t)grid->stride * (rows + 2));
+    grid->words = grid->data + grid->stride + 1;
+    clearLifeGrid(grid);
+}
+
+void freeLifeGrid(LifeGrid *grid) {
+    FREE_ALIGNED(grid->data);
+    grid->data = NULL;
+    grid->words = NULL;
+    grid->rows = 0;
+    grid->cols = 0;
+}
+
+void clearLifeGrid(LifeGrid *grid) { memset(grid->data, 0, sizeof(uint64_t) * grid->stride * (grid->rows + 2)); }
+
+static uint64_t *lifeRow(const LifeGrid *grid, int row) { return grid->words + (ptrdiff_t)row * grid->stride; }
+
+// Mask of the bits in the last word of a row that hold cells.
+static uint64_t lastWordMask(const LifeGrid *grid) {
+    int tail = grid->cols % LIFE_WORD_BITS;
+    return tail == 0 ? ~(uint64_t)0 : ((uint64_t)1 << tail) - 1;
+}
+
+bool getLifeCell(const LifeGrid *grid, int row, int col) {
+    return (lifeRow(grid, row)[col / LIFE_WORD_BITS] >> (col % LIFE_WORD_BITS)) & 1;
+}
+
+void setLifeCell(LifeGrid *grid, int row, int col, bool alive) {
+    uint64_t *word = &lifeRow(grid, row)[col / LIFE_WORD_BITS];
+    uint64_t bit = (uint64_t)1 << (col % LIFE_WORD_BITS);
+    *word = alive ? *word | bit : *word & ~bit;
+}
+
+long countLife(const LifeGrid *grid) {
+    long count = 0;
+    uint64_t mask = lastWordMask(grid);
+    for (int row = 0; row < grid->rows; row++) {
+        const uint64_t *words = lifeRow(grid, row);
+        for (int w = 0; w < grid->rowWords; w++) {
+            uint64_t word = w == grid->rowWords - 1 ? words[w] & mask : words[w];
+            count += __builtin_popcountll(word);
+        }
+    }
+    return count;
+}
+
+// Fills the halo from the opposite edge, or with dead cells if the grid does not wrap. When the cols do not fill the
+// last word of a row, the bit after the last col is used as the east halo instead of the halo word.
+static void refreshLifeHalo(LifeGrid *grid) {
+    int tail = grid->cols % LIFE_WORD_BITS;
+    uint64_t mask = lastWordMask(grid);
+    for (int row = 0; row < grid->rows; row++) {
+        uint64_t *words = lifeRow(grid, row);
+        words[grid->rowWords - 1] &= mask;
+        words[-1] = 0;
+        words[grid->rowWords] = 0;
+        if (grid->wraps) {
+            words[-1] = (uint64_t)getLifeCell(grid, row, grid->cols - 1) << (LIFE_WORD_BITS - 1);
+            uint64_t first = words[0] & 1;
+            if (tail != 0) {
+                words[grid->rowWords - 1] |= first << tail;
+            } else {
+                words[grid->rowWords] = first;
+            }
+        }
+    }
+
+    size_t rowBytes = sizeof(uint64_t) * grid->stride;
+    uint64_t *above = lifeRow(grid, -1) - 1;
+    uint64_t *below = lifeRow(grid, grid->rows) - 1;
+    if (grid->wraps) {
+        memcpy(above, lifeRow(grid, grid->rows - 1) - 1, rowBytes);
+        memcpy(below, lifeRow(grid, 0) - 1, rowBytes);
+    } else {
+        memset(above, 0, rowBytes);
+        memset(below, 0, rowBytes);
+    }
+}
+
+typedef struct LifeStep {
+    const LifeGrid *grid;
+    LifeGrid *result;
+    // Neighbour counts that give birth, and that let a live cell survive.
+    int births[LIFE_MAX_NEIGHBOURS + 1];
+    int birthCount;
+    int survivals[LIFE_MAX_NEIGHBOURS + 1];
+    int survivalCount;
+} LifeStep;
+
+// Adds three one bit numbers in each bit position, giving the low bits in `sum` and the high bits in `carry`.
+static inline void fullAdd(uint64_t a, uint64_t b, uint64_t c, uint64_t *sum, uint64_t *carry) {
+    uint64_t half = a ^ b;
+    *sum = half ^ c;
+    *carry = (a & b) | (half & c);
+}
+
+// Mask of the bits where the neighbour count, held as the bit planes `count[0..3]`, equals `n`.
+static inline uint64_t countEquals(const uint64_t count[4], int n) {
+    uint64_t equal = ~(uint64_t)0;
+    for (int bit = 0; bit < 4; bit++) {
+        equal &= (n >> bit) & 1 ? count[bit] : ~count[bit];
+    }
+    return equal;
+}
+
+// Steps the 64 cells in word `w` of the row `centre`, between the rows `above` and `below`.
+static inline uint64_t stepWord(const LifeStep *step, const uint64_t *above, const uint64_t *centre,
+                                const uint64_t *below, int w) {
+    // Each neighbour of every cell in the word, lined up with the cell. Bit `i` of `west` is the cell west of bit `i`.
+    uint64_t nw = (above[w] << 1) | (above[w - 1] >> (LIFE_WORD_BITS - 1));
+    uint64_t n = above[w];
+    uint64_t ne = (above[w] >> 1) | (above[w + 1] << (LIFE_WORD_BITS - 1));
+    uint64_t west = (centre[w] << 1) | (centre[w - 1] >> (LIFE_WORD_BITS - 1));
+    uint64_t east = (centre[w] >> 1) | (centre[w + 1] << (LIFE_WORD_BITS - 1));
+    uint64_t sw = (below[w] << 1) | (below[w - 1] >> (LIFE_WORD_BITS - 1));
+    uint64_t s = below[w];
+    uint64_t se = (below[w] >> 1) | (below[w + 1] << (LIFE_WORD_BITS - 1));
+
+    // Sum the eight neighbours of all 64 cells at once with a tree of adders, one bit plane at a time
+    uint64_t ones1, twos1, ones2, twos2, ones3, twos3;
+    fullAdd(nw, n, ne, &ones1, &twos1);
+    fullAdd(west, east, sw, &ones2, &twos2);
+    ones3 = s ^ se;
+    twos3 = s & se;
+
+    uint64_t ones, twos4, twos5, fours1, fours2;
+    fullAdd(ones1, ones2, ones3, &ones, &twos4);
+    fullAdd(twos1, twos2, twos3, &twos5, &fours1);
+    uint64_t twos = twos5 ^ twos4;
+    fours2 = twos5 & twos4;
+
+    uint64_t count[4] = {ones, twos, fours1 ^ fours2, fours1 & fours2};
+
+    uint64_t born = 0;
+    for (int i = 0; i < step->birthCount; i++) {
+        born |= countEquals(count, step->births[i]);
+    }
+    uint64_t survive = 0;
+    for (int i = 0; i < step->survivalCount; i++) {
+        survive |= countEquals(count, step->survivals[i]);
+    }
+    return (centre[w] & survive) | (~centre[w] & born);
+}
+
+static void stepLifeRows(int worker, int workers, void *data) {
+    const LifeStep *step = data;
+    const LifeGrid *grid = step->grid;
+    LifeGrid *result = step->result;
+    uint64_t mask = lastWordMask(grid);
+
+    int start = grid->rows * worker / workers;
+    int end = grid->rows * (worker + 1) / workers;
+    for (int row = start; row < end; row++) {
+        const uint64_t *above = lifeRow(grid, row - 1);
+        const uint64_t *centre = lifeRow(grid, row);
+        const uint64_t *below = lifeRow(grid, row + 1);
+        uint64_t *next = lifeRow(result, row);
+        for (int w = 0; w < grid->rowWords; w++) {
+            next[w] = stepWord(step, above, centre, below, w);
+        }
+        // Keep the bits past the last col dead, so they never come to life in a grid that does not wrap
+        next[grid->rowWords - 1] &= mask;
+    }
+}
+
+// Writes the generation after `grid` into `result`, which must be the same size.
+void stepLife(LifeGrid *grid, LifeGrid *result, LifeRule rule) {
+    if (grid->rows != result->rows || grid->cols != result->cols) {
+        LogMessage(LOG_ERROR, "Cannot step a %dx%d life grid into a %dx%d one", grid->rows, grid->cols, result->rows,
+                   result->cols);
+        return;
+    }
+    refreshLifeHalo(grid);
+
+    LifeStep step = {.grid = grid, .result = result, .birthCount = 0, .survivalCount = 0};
+    for (int n = 0; n <= LIFE_MAX_NEIGHBOURS; n++) {
+        if (rule.birth & (1u << n)) {
+            step.births[step.birthCount++] = n;
+        }
+        if (rule.survival & (1u << n)) {
+            step.survivals[step.survivalCount++] = n;
+        }
+    }
+    runWorkers(stepLifeRows, &step);
+}
+
+// The rule applied to a single cell the plain way, by counting its neighbours. `checkLife` holds `stepLife` to it.
+static bool stepLifeCell(const LifeGrid *grid, int row, int col, LifeRule rule) {
+    int count = 0;
+    for (int dr = -1; dr <= 1; dr++) {
+        for (int dc = -1; dc <= 1; dc++) {
+            int r = row + dr;
+            int c = col + dc;
+            if (grid->wraps) {
+                r = (r + grid->rows) % grid->rows;
+                c = (c + grid->cols) % grid->cols;
+            } else if (r < 0 || r >= grid->rows || c < 0 || c >= grid->cols) {
+                continue;
+            }
+            count += (dr != 0 || dc != 0) && getLifeCell(grid, r, c);
+        }
+    }
+    uint16_t counts = getLifeCell(grid, row, col) ? rule.survival : rule.birth;
+    return (counts >> count) & 1;
+}
+
+// Steps `grid` a generation, checking every cell against `stepLifeCell`. The grids are swapped afterwards.
+static bool checkLifeStep(LifeGrid *grid, LifeGrid *result, LifeRule rule, int generation) {
+    stepLife(grid, result, rule);
+    for (int row = 0; row < grid->rows; row++) {
+        for (int col = 0; col < grid->cols; col++) {
+            if (getLifeCell(result, row, col) != stepLifeCell(grid, row, col, rule)) {
+                LogMessage(LOG_ERROR, "Life differs from the plain rule at (%d, %d) in generation %d", row, col,
+                           generation);
+                return false;
+            }
+        }
+    }
+
+    LifeGrid temp = *grid;
+    *grid = *result;
+    *result = temp;
+    return true;
+}
+
+// Conformance check of `stepLife` against the plain rule, on random soup in grids whose rows do and do not fill their
+// last word, with and without wrapping. A glider on a wrapping grid must also come back to where it started, after
+// crossing every edge. Returns `false` and logs the first difference.
+bool checkLife() {
+#define CHECK_GENERATIONS 16
+#define CHECK_GLIDER_SIZE 64
+
+    LifeRule rule;
+    parseLifeRule("B3/S23", &rule);
+
+    static const int sizes[][2] = {{24, 150}, {17, 64}};
+    bool ok = true;
+    unsigned int seed = 1;
+    for (int i = 0; i < 4 && ok; i++) {
+        LifeGrid grid, result;
+        initLifeGrid(&grid, sizes[i / 2][0], sizes[i / 2][1], i % 2 == 1);
+        initLifeGrid(&result, grid.rows, grid.cols, grid.wraps);
+        for (int row = 0; row < grid.rows; row++) {
+            for (int col = 0; col < grid.cols; col++) {
+                seed = seed * 1103515245 + 12345;
+                setLifeCell(&grid, row, col, (seed >> 16) % 3 == 0);
+            }
+        }
+        for (int generation = 0; generation < CHECK_GENERATIONS && ok; generation++) {
+            ok = checkLifeStep(&grid, &result, rule, generation);
+        }
+        freeLifeGrid(&grid);
+        freeLifeGrid(&result);
+    }
+
+    // A glider moves a cell diagonally every four generations
+    static const int glider[][2] = {{0, 1}, {1, 2}, {2, 0}, {2, 1}, {2, 2}};
+    LifeGrid grid, result;
+    initLifeGrid(&grid, CHECK_GLIDER_SIZE, CHECK_GLIDER_SIZE, true);
+    initLifeGrid(&result, CHECK_GLIDER_SIZE, CHECK_GLIDER_SIZE, true);
+    for (int i = 0; i < 5; i++) {
+        setLifeCell(&grid, glider[i][0], glider[i][1], true);
+    }
+    for (int generation = 0; generation < 4 * CHECK_GLIDER_SIZE && ok; generation++) {
+        ok = checkLifeStep(&grid, &result, rule, generation);
+    }
+    for (int i = 0; i < 5 && ok; i++) {
+        ok = getLifeCell(&grid, glider[i][0], glider[i][1]);
+    }
+    if (ok && countLife(&grid) != 5) {
+        ok = false;
+    }
+    if (!ok) {
+        LogMessage(LOG_ERROR, "Life glider did not come back to where it started");
+    }
+    freeLifeGrid(&grid);
+    freeLifeGrid(&result);
+
+    return ok;
+
+#undef CHECK_GENERATIONS
+#undef CHECK_GLIDER_SIZE
+}
+
+// Draws the live cells of `grid` one unit across, with the cell at row 0, col 0 at `x`, `y`. Only the rows in `view`
+// are drawn, and words without a live cell are skipped.
+void drawLifeGrid(const LifeGrid *grid, int x, int y, Rectangle view) {
+    int rowStart = view.y - y > 0 ? (int)(view.y - y) : 0;
+    int rowEnd = view.y + view.height - y + 1 < grid->rows ? (int)(view.y + view.height - y + 1) : grid->rows;
+    for (int row = rowStart; row < rowEnd; row++) {
+        const uint64_t *words = lifeRow(grid, row);
+        for (int w = 0; w < grid->rowWords; w++) {
+            uint64_t word = words[w];
+            while (word != 0) {
+                int col = w * LIFE_WORD_BITS + __builtin_ctzll(word);
+                word &= word - 1;
+                // The bit after the last col may hold the east halo
+                if (col < grid->cols) {
+                    DrawRectangle(x + col, y + row, 1, 1, WHITE);
+                }
+            }
+        }
+    }
+}
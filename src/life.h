@@ -0,0 +1,48 @@
+#ifndef ptest_life_h
+#define ptest_life_h
+
+#include "raylib.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Number of cells packed into each word of a life grid.
+#define LIFE_WORD_BITS 64
+
+// A life-like rule. A dead cell with `n` live neighbours is born if bit `n` of `birth` is set, and a live one survives
+// if bit `n` of `survival` is set, so Conway's life (B3/S23) is `{1 << 3, 1 << 2 | 1 << 3}`.
+typedef struct LifeRule {
+    uint16_t birth;
+    uint16_t survival;
+} LifeRule;
+
+// A grid of binary cells packed into bits, so a single operation on a word updates 64 cells at once. Bit `i` of word
+// `w` in a row is the cell in col `w * LIFE_WORD_BITS + i`.
+//
+// Like `Grid`, every row has a halo word at each end and there is a halo row above and below, so stepping never needs
+// to check for the edge. The halo holds the opposite edge when the grid wraps and dead cells otherwise.
+typedef struct LifeGrid {
+    uint64_t *data;  // Allocation including the halo.
+    uint64_t *words; // First word of row 0.
+    int rows;
+    int cols;
+    int rowWords; // Words holding the cells of a row, without the halo.
+    int stride;   // Words between the start of one row and the next.
+    bool wraps;
+} LifeGrid;
+
+bool parseLifeRule(const char *text, LifeRule *rule);
+
+void initLifeGrid(LifeGrid *grid, int rows, int cols, bool wraps);
+void freeLifeGrid(LifeGrid *grid);
+void clearLifeGrid(LifeGrid *grid);
+
+bool getLifeCell(const LifeGrid *grid, int row, int col);
+void setLifeCell(LifeGrid *grid, int row, int col, bool alive);
+long countLife(const LifeGrid *grid);
+
+void stepLife(LifeGrid *grid, LifeGrid *result, LifeRule rule);
+bool checkLife();
+
+void drawLifeGrid(const LifeGrid *grid, int x, int y, Rectangle view);
+
+#endif // ptest_life_h
@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdlib.h>
 #include <time.h>
 
@@ -5,25 +6,39 @@
 #include "debug.h"
 #include "draw.h"
 #include "grid.h"
+#include "kernels.h"
+#include "life.h"
+#include "material.h"
 #include "quadtree.h"
 #include "raylib.h"
 #include "rlgl.h"
-#include "table.h"
 #include "ui.h"
+#include "workers.h"
+#include "world.h"
 
 #define WIDTH 1728
 #define HEIGHT 1024
 #define CELLPOWER 5
 #define GRIDWIDTH 2048.0f / 2
+#define QUADTREE_CELL_SIZE (GRIDWIDTH / (1 << CELLPOWER))
 #define UPDATE_RATE 60
 #define FLUID_AMOUNT 64
 
 #define CAMERA_SPEED 8
+#define FAST_FORWARD_GENERATIONS 8
+#define QUADTREE_LEAP_GENERATIONS 1024
+#define QUADTREE_UNDERLAY_MIN_PIXELS 4
+#define WORLD_STORE_PATH "world.store"
+#define WORLD_RESIDENT_CHUNKS 4096
+#define LIFE_SIZE 1024
+#define LIFE_RULE "B3/S23"
 
 typedef enum {
     TITLE,
     GRID,
     QUADTREE,
+    WORLD,
+    LIFE,
 } Scene;
 
 typedef enum { ADD, DELETE } Mode;
@@ -42,6 +57,12 @@ typedef struct GameData {
 
     QuadTree *quadtree;
 
+    World world;
+
+    LifeGrid life1;
+    LifeGrid life2;
+    LifeRule lifeRule;
+
     Mode mode;
 
     Camera2D camera;
@@ -49,6 +70,8 @@ typedef struct GameData {
 
     Button buttonStart;
     Button buttonQuadTree;
+    Button buttonWorld;
+    Button buttonLife;
 
     bool paused;
 } GameData;
@@ -56,8 +79,6 @@ typedef struct GameData {
 static GameData gameData;
 static bool logFlag;
 
-Table quadtrees;
-
 const Vector2 origin = (Vector2){0.0f, 0.0f};
 
 bool mouseDown(MouseButton *button) {
@@ -77,6 +98,10 @@ void toGrid() { gameData.scene = GRID; }
 
 void toQuadTree() { gameData.scene = QUADTREE; }
 
+void toWorld() { gameData.scene = WORLD; }
+
+void toLife() { gameData.scene = LIFE; }
+
 void initGameData() {
     gameData.scene = TITLE;
 
@@ -92,9 +117,29 @@ void initGameData() {
     gameData.gridx = -gameData.gridWidthScale * width / 2;
     gameData.gridy = -gameData.gridHeightScale * width / 2;
     gameData.gridTexture = LoadRenderTexture(width, width);
+    initWorkers(processorCount());
+
+    // Compiled before the workers first step anything, as they share the tables
+    getMaterials();
+#ifdef DEBUG_GRID
+    checkGrid();
+#endif
 
     initQuadTable();
     gameData.quadtree = newEmptyQuadTree(CELLPOWER);
+    addQuadTreeRoot(&gameData.quadtree);
+
+    initWorld(&gameData.world);
+    if (!pageWorld(&gameData.world, WORLD_STORE_PATH, WORLD_RESIDENT_CHUNKS)) {
+        LogMessage(LOG_WARNING, "Keeping the world in memory");
+    }
+
+    initLifeGrid(&gameData.life1, LIFE_SIZE, LIFE_SIZE, true);
+    initLifeGrid(&gameData.life2, LIFE_SIZE, LIFE_SIZE, true);
+    parseLifeRule(LIFE_RULE, &gameData.lifeRule);
+#ifdef DEBUG_LIFE
+    checkLife();
+#endif
 
     gameData.mode = ADD;
 
@@ -105,6 +150,10 @@ void initGameData() {
         newButton((Rectangle){WIDTH / 2 - 200 / 2 - 200, HEIGHT / 2, 200, 100}, true, "Grid", 32, toGrid);
     gameData.buttonQuadTree =
         newButton((Rectangle){WIDTH / 2 - 200 / 2 + 200, HEIGHT / 2, 200, 100}, true, "QuadTree", 32, toQuadTree);
+    gameData.buttonWorld =
+        newButton((Rectangle){WIDTH / 2 - 200 / 2, HEIGHT / 2 + 150, 200, 100}, true, "World", 32, toWorld);
+    gameData.buttonLife =
+        newButton((Rectangle){WIDTH / 2 - 200 / 2, HEIGHT / 2 + 300, 200, 100}, true, "Life", 32, toLife);
 
     gameData.paused = true;
 
@@ -114,6 +163,11 @@ void initGameData() {
 void freeGameData() {
     freeGrid(&gameData.grid1);
     freeGrid(&gameData.grid2);
+    freeWorld(&gameData.world);
+    freeLifeGrid(&gameData.life1);
+    freeLifeGrid(&gameData.life2);
+    freeWorkers();
+    freeQuadTrees();
     UnloadRenderTexture(gameData.gridTexture);
 }
 
@@ -121,6 +175,8 @@ void updateSceneTitle() {
     if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
         tryButtonPress(gameData.buttonStart);
         tryButtonPress(gameData.buttonQuadTree);
+        tryButtonPress(gameData.buttonWorld);
+        tryButtonPress(gameData.buttonLife);
     }
 }
 
@@ -170,18 +226,18 @@ void updateSceneGrid() {
             CellValue *result = NULL;
             if (getCellAt(&gameData.grid1, gameData.gridx, gameData.gridy, worldPos.x, worldPos.y, gameData.gridWidthScale,
                           gameData.gridHeightScale, &result)) {
-                result->material = WATER;
-                result->type = FLUID;
+                result->kind = CELL_KIND(FLUID, WATER);
                 result->state = 32;
-                result->settled = false;
+                UNSETTLE(*result);
+                markCellChanged(&gameData.grid1, result);
             }
         } else if (button == MOUSE_BUTTON_RIGHT) {
             CellValue *result = NULL;
             if (getCellAt(&gameData.grid1, gameData.gridx, gameData.gridy, worldPos.x, worldPos.y, gameData.gridWidthScale,
                           gameData.gridHeightScale, &result)) {
-                result->material = NONE;
-                result->type = VACUUM;
+                result->kind = CELL_KIND(VACUUM, NONE);
                 result->state = 0;
+                markCellChanged(&gameData.grid1, result);
             }
         }
     }
@@ -191,10 +247,10 @@ void updateSceneGrid() {
         CellValue *result = NULL;
         if (getCellAt(&gameData.grid1, gameData.gridx, gameData.gridy, worldPos.x, worldPos.y, gameData.gridWidthScale,
                       gameData.gridHeightScale, &result)) {
-            result->material = LAVA;
-            result->type = FLUID;
+            result->kind = CELL_KIND(FLUID, LAVA);
             result->state = 32;
-            result->settled = false;
+            UNSETTLE(*result);
+            markCellChanged(&gameData.grid1, result);
         }
     }
     if (IsKeyDown(KEY_T)) {
@@ -202,10 +258,10 @@ void updateSceneGrid() {
         CellValue *result = NULL;
         if (getCellAt(&gameData.grid1, gameData.gridx, gameData.gridy, worldPos.x, worldPos.y, gameData.gridWidthScale,
                       gameData.gridHeightScale, &result)) {
-            result->material = STONE;
-            result->type = SOLID;
+            result->kind = CELL_KIND(SOLID, STONE);
             result->state = 32;
-            result->settled = false;
+            UNSETTLE(*result);
+            markCellChanged(&gameData.grid1, result);
         }
     }
 
@@ -228,6 +284,26 @@ void updateSceneGrid() {
         logFlag = !logFlag;
     }
 
+    if (IsKeyPressed(KEY_M)) {
+        // Toggle between stepping on every core and the serial path
+        initWorkers(workerCount() == 1 ? processorCount() : 1);
+        LogMessage(LOG_INFO, "Stepping grid with %d workers", workerCount());
+    }
+
+    if (IsKeyPressed(KEY_K)) {
+        // Toggle between the vector kernels and the scalar ones
+        setKernelLevel(getKernels()->level == KERNELS_SCALAR ? KERNELS_AVX2 : KERNELS_SCALAR);
+        LogMessage(LOG_INFO, "Stepping grid with %s kernels", getKernels()->name);
+    }
+
+    if (IsKeyPressed(KEY_B)) {
+        // Cycle through walls, sinks and wrapping around
+        GridBoundary boundary = (gameData.grid1.boundary + 1) % (BOUNDARY_WRAP + 1);
+        setGridBoundary(&gameData.grid1, boundary);
+        setGridBoundary(&gameData.grid2, boundary);
+        LogMessage(LOG_INFO, "Grid boundary set to %d", boundary);
+    }
+
     if (!gameData.paused && gameData.timer > 1.0f / (float)UPDATE_RATE) {
 
         clock_t begin = 0;
@@ -235,7 +311,9 @@ void updateSceneGrid() {
             begin = clock();
         }
 
-        evolveGrid(&gameData.grid1, &gameData.grid2);
+        // Holding G fast forwards, only drawing every few generations
+        int generations = IsKeyDown(KEY_G) ? FAST_FORWARD_GENERATIONS : 1;
+        advanceGrid(&gameData.grid1, &gameData.grid2, generations);
 
         // Swapping grids
         Grid temp = gameData.grid1;
@@ -252,20 +330,30 @@ void updateSceneGrid() {
     }
 }
 
+// Width the quadtree is drawn at. Cells stay the same size as the root grows and shrinks.
+static float quadtreeWidth() { return QUADTREE_CELL_SIZE * maxQuads(gameData.quadtree); }
+
 void updateSceneQuadTree() {
     cameraUpdate();
 
     MouseButton button;
     if (mouseDown(&button)) {
         Vector2 mousePos = GetScreenToWorld2D(GetMousePosition(), gameData.camera);
-        if (IN_SQUARE(mousePos, origin, GRIDWIDTH)) {
+
+        // The universe is unbounded, so the root grows out to wherever fluid is added
+        while (button == MOUSE_BUTTON_LEFT && !IN_SQUARE(mousePos, origin, quadtreeWidth())) {
+            gameData.quadtree = growQuadtree(gameData.quadtree);
+        }
+
+        if (IN_SQUARE(mousePos, origin, quadtreeWidth())) {
             QuadTree *newTree = NULL;
 
             if (button == MOUSE_BUTTON_LEFT) {
                 FluidValue newFluid = (FluidValue){FLUID_WATER, FLUID_AMOUNT};
-                newTree = setPointInQuadTree(mousePos, origin, GRIDWIDTH, gameData.quadtree, FLUID_VALUE(newFluid));
+                newTree =
+                    setPointInQuadTree(mousePos, origin, quadtreeWidth(), gameData.quadtree, FLUID_VALUE(newFluid));
             } else if (button == MOUSE_BUTTON_RIGHT) {
-                newTree = setPointInQuadTree(mousePos, origin, GRIDWIDTH, gameData.quadtree, INT_VALUE(0));
+                newTree = setPointInQuadTree(mousePos, origin, quadtreeWidth(), gameData.quadtree, INT_VALUE(0));
             }
 
             if (newTree != NULL) {
@@ -286,6 +374,10 @@ void updateSceneQuadTree() {
         gameData.quadtree = evolveQuadtree(gameData.quadtree);
     }
 
+    if (IsKeyPressed(KEY_G) && gameData.paused) {
+        gameData.quadtree = advanceQuadtree(gameData.quadtree, QUADTREE_LEAP_GENERATIONS);
+    }
+
     if (!gameData.paused) {
         if (gameData.timer > 1.0f / (float)UPDATE_RATE) {
             gameData.quadtree = evolveQuadtree(gameData.quadtree);
@@ -295,6 +387,86 @@ void updateSceneQuadTree() {
     }
 }
 
+void updateSceneWorld() {
+    cameraUpdate();
+
+    // Cells of the world are one unit across, with cell (0, 0) at the origin
+    Vector2 worldPos = GetScreenToWorld2D(GetMousePosition(), gameData.camera);
+    int row = (int)floorf(worldPos.y);
+    int col = (int)floorf(worldPos.x);
+
+    MouseButton button;
+    if (mouseDown(&button)) {
+        if (button == MOUSE_BUTTON_LEFT) {
+            setWorldCell(&gameData.world, row, col, (CellValue){CELL_KIND(FLUID, WATER), 0, 32});
+        } else if (button == MOUSE_BUTTON_RIGHT) {
+            setWorldCell(&gameData.world, row, col, (CellValue){CELL_KIND(VACUUM, NONE), 0, 0});
+        }
+    }
+
+    if (IsKeyDown(KEY_L)) {
+        setWorldCell(&gameData.world, row, col, (CellValue){CELL_KIND(FLUID, LAVA), 0, 32});
+    }
+    if (IsKeyDown(KEY_T)) {
+        setWorldCell(&gameData.world, row, col, (CellValue){CELL_KIND(SOLID, STONE), 0, 32});
+    }
+
+    if (IsKeyPressed(KEY_SPACE)) {
+        gameData.paused = !gameData.paused;
+    }
+
+    if (IsKeyPressed(KEY_F) && gameData.paused) {
+        evolveWorld(&gameData.world);
+        gameData.timer = 0.0f;
+    }
+
+    if (!gameData.paused && gameData.timer > 1.0f / (float)UPDATE_RATE) {
+        evolveWorld(&gameData.world);
+        gameData.timer = 0.0f;
+    }
+}
+
+// Steps the life grid a generation and swaps the grids.
+static void stepSceneLife() {
+    stepLife(&gameData.life1, &gameData.life2, gameData.lifeRule);
+
+    LifeGrid temp = gameData.life1;
+    gameData.life1 = gameData.life2;
+    gameData.life2 = temp;
+
+    gameData.timer = 0.0f;
+}
+
+void updateSceneLife() {
+    cameraUpdate();
+
+    // Cells of the life grid are one unit across, with the grid centred on the origin
+    Vector2 worldPos = GetScreenToWorld2D(GetMousePosition(), gameData.camera);
+    int row = (int)floorf(worldPos.y) + LIFE_SIZE / 2;
+    int col = (int)floorf(worldPos.x) + LIFE_SIZE / 2;
+
+    MouseButton button;
+    if (mouseDown(&button) && 0 <= row && row < LIFE_SIZE && 0 <= col && col < LIFE_SIZE) {
+        setLifeCell(&gameData.life1, row, col, button == MOUSE_BUTTON_LEFT);
+    }
+
+    if (IsKeyPressed(KEY_C)) {
+        clearLifeGrid(&gameData.life1);
+    }
+
+    if (IsKeyPressed(KEY_SPACE)) {
+        gameData.paused = !gameData.paused;
+    }
+
+    if (IsKeyPressed(KEY_F) && gameData.paused) {
+        stepSceneLife();
+    }
+
+    if (!gameData.paused && gameData.timer > 1.0f / (float)UPDATE_RATE) {
+        stepSceneLife();
+    }
+}
+
 void update() {
     float dt = GetFrameTime();
     gameData.timer += dt;
@@ -310,6 +482,12 @@ void update() {
     case QUADTREE:
         updateSceneQuadTree();
         break;
+    case WORLD:
+        updateSceneWorld();
+        break;
+    case LIFE:
+        updateSceneLife();
+        break;
     }
 }
 
@@ -319,6 +497,8 @@ void drawSceneTitle() {
 
     drawButton(gameData.buttonStart);
     drawButton(gameData.buttonQuadTree);
+    drawButton(gameData.buttonWorld);
+    drawButton(gameData.buttonLife);
 }
 
 void drawSceneGrid() {
@@ -347,15 +527,22 @@ void drawSceneQuadTree() {
 
     BeginMode2D(gameData.camera);
 
-    float gridCellSize = miniumumQuadSize(GRIDWIDTH, gameData.quadtree);
-    int cells = maxQuads(gameData.quadtree);
+    float gridCellSize = miniumumQuadSize(quadtreeWidth(), gameData.quadtree);
+    int64_t cells = maxQuads(gameData.quadtree);
 
-    drawQuadTree(*gameData.quadtree, origin, GRIDWIDTH, gameData.camera);
+    drawQuadTree(*gameData.quadtree, origin, quadtreeWidth(), gameData.camera);
     // drawQuadFromPosition(mousePos, gameData.quadtree, (Vector2){0.0f, 0.0f}, GRIDWIDTH);
-    drawGridUnderlay(origin, cells, cells, gridCellSize);
+
+    // Zoomed out far enough, the lines would run together while there are more and more of them to draw
+    if (gridCellSize * gameData.camera.zoom >= QUADTREE_UNDERLAY_MIN_PIXELS) {
+        Vector2 topLeft = GetScreenToWorld2D((Vector2){0, 0}, gameData.camera);
+        Vector2 bottomRight = GetScreenToWorld2D((Vector2){WIDTH, HEIGHT}, gameData.camera);
+        drawGridUnderlay(origin, cells, cells, gridCellSize,
+                         (Rectangle){topLeft.x, topLeft.y, bottomRight.x - topLeft.x, bottomRight.y - topLeft.y});
+    }
 
     EndMode2D();
-    DrawText(TextFormat("%d, %f", cells, gridCellSize), 100, 200, 32, WHITE);
+    DrawText(TextFormat("%lld, %f", (long long)cells, gridCellSize), 100, 200, 32, WHITE);
 
     DrawText(TextFormat("%s", gameData.mode == ADD ? "ADD" : "DELETE"), 100, HEIGHT - 200, 32, WHITE);
     DrawText(TextFormat("%s", gameData.paused ? "Paused" : ""), WIDTH - 200, 200, 32, RED);
@@ -364,6 +551,39 @@ void drawSceneQuadTree() {
 #endif
 }
 
+void drawSceneWorld() {
+    ClearBackground(BLACK);
+
+    BeginMode2D(gameData.camera);
+
+    Vector2 topLeft = GetScreenToWorld2D((Vector2){0, 0}, gameData.camera);
+    Vector2 bottomRight = GetScreenToWorld2D((Vector2){WIDTH, HEIGHT}, gameData.camera);
+    drawWorld(&gameData.world,
+              (Rectangle){topLeft.x, topLeft.y, bottomRight.x - topLeft.x, bottomRight.y - topLeft.y});
+
+    EndMode2D();
+
+    DrawText(TextFormat("Chunks: %d, resident: %d", gameData.world.count, gameData.world.resident), 10, 10, 20, WHITE);
+    DrawText(TextFormat("%s", gameData.paused ? "Paused" : ""), WIDTH - 200, 200, 32, RED);
+}
+
+void drawSceneLife() {
+    ClearBackground(BLACK);
+
+    BeginMode2D(gameData.camera);
+
+    Vector2 topLeft = GetScreenToWorld2D((Vector2){0, 0}, gameData.camera);
+    Vector2 bottomRight = GetScreenToWorld2D((Vector2){WIDTH, HEIGHT}, gameData.camera);
+    DrawRectangleLines(-LIFE_SIZE / 2, -LIFE_SIZE / 2, LIFE_SIZE, LIFE_SIZE, DARKGRAY);
+    drawLifeGrid(&gameData.life1, -LIFE_SIZE / 2, -LIFE_SIZE / 2,
+                 (Rectangle){topLeft.x, topLeft.y, bottomRight.x - topLeft.x, bottomRight.y - topLeft.y});
+
+    EndMode2D();
+
+    DrawText(TextFormat("%s, live: %ld", LIFE_RULE, countLife(&gameData.life1)), 10, 10, 20, WHITE);
+    DrawText(TextFormat("%s", gameData.paused ? "Paused" : ""), WIDTH - 200, 200, 32, RED);
+}
+
 void draw() {
     BeginDrawing();
 
@@ -386,6 +606,12 @@ void draw() {
     case QUADTREE:
         drawSceneQuadTree();
         break;
+    case WORLD:
+        drawSceneWorld();
+        break;
+    case LIFE:
+        drawSceneLife();
+        break;
     }
 
     DrawFPS(WIDTH - 80, HEIGHT - 30);
@@ -0,0 +1,82 @@
+#include "material.h"
+#include "debug.h"
+
+#include <string.h>
+
+// clang-format off
+static const MaterialDefinition materialDefinitions[] = {
+    { NONE,  "vacuum", VACUUM, 0,  0, DARKGRAY },
+    { AIR,   "air",    GAS,    0,  0, DARKGRAY },
+    { WATER, "water",  FLUID,  64, 4, BLUE },
+    { LAVA,  "lava",   FLUID,  64, 4, RED },
+    { STONE, "stone",  SOLID,  0,  0, GRAY },
+};
+
+static const Reaction reactions[] = {
+    { LAVA, WATER, STONE },
+};
+// clang-format on
+
+#define DEFINITION_COUNT (int)(sizeof(materialDefinitions) / sizeof(materialDefinitions[0]))
+#define REACTION_COUNT (int)(sizeof(reactions) / sizeof(reactions[0]))
+
+static MaterialTables tables;
+static const char *names[MATERIAL_SLOTS];
+static bool compiled = false;
+
+// Clamps `value` into a byte of the tables, warning about the definition it came from if it does not fit.
+static uint8_t tableByte(const MaterialDefinition *definition, const char *field, int value) {
+    if (value < 0 || value > UINT8_MAX) {
+        LogMessage(LOG_WARNING, "%s of %s is %d, which is outside [0, %d]", field, definition->name, value, UINT8_MAX);
+        return value < 0 ? 0 : UINT8_MAX;
+    }
+    return (uint8_t)value;
+}
+
+static void compileMaterials() {
+    memset(&tables, 0, sizeof(tables));
+    CType types[MATERIAL_SLOTS] = {VACUUM};
+
+    for (int i = 0; i < DEFINITION_COUNT; i++) {
+        const MaterialDefinition *definition = &materialDefinitions[i];
+        CMaterial material = definition->material;
+        tables.maxState[material] = tableByte(definition, "maxState", definition->maxState);
+        tables.flowRate[material] = tableByte(definition, "flowRate", definition->flowRate);
+        tables.colors[material] = definition->color;
+        types[material] = definition->type;
+        names[material] = definition->name;
+    }
+
+    for (int i = 0; i < REACTION_COUNT; i++) {
+        const Reaction *reaction = &reactions[i];
+        int count = tables.reactionCount[reaction->material];
+        if (count == MATERIAL_MAX_REACTIONS) {
+            LogMessage(LOG_WARNING, "%s has more than %d reactions, ignoring the one with %s",
+                       materialName(reaction->material), MATERIAL_MAX_REACTIONS, materialName(reaction->reactant));
+            continue;
+        }
+
+        tables.reactants[reaction->material] |= MATERIAL_BIT(reaction->reactant);
+        tables.reactionReactants[reaction->material][count] = reaction->reactant;
+        tables.reactionKinds[reaction->material][count] = CELL_KIND(types[reaction->result], reaction->result);
+        tables.reactionCount[reaction->material]++;
+    }
+}
+
+// Returns the compiled material tables, compiling them the first time. Must first be called from a single thread.
+const MaterialTables *getMaterials() {
+    if (!compiled) {
+        compileMaterials();
+        compiled = true;
+    }
+    return &tables;
+}
+
+const char *materialName(CMaterial material) {
+    getMaterials();
+    const char *name = names[material & CELL_MATERIAL_MASK];
+    return name != NULL ? name : "unknown";
+}
+
+#undef DEFINITION_COUNT
+#undef REACTION_COUNT
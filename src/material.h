@@ -0,0 +1,46 @@
+#ifndef ptest_material_h
+#define ptest_material_h
+
+#include "value.h"
+
+// Room for every material the `kind` of a cell can hold.
+#define MATERIAL_SLOTS (CELL_MATERIAL_MASK + 1)
+
+// Most reactions a single material can have.
+#define MATERIAL_MAX_REACTIONS 4
+
+// How cells of a material behave and look. Every material is listed in `materialDefinitions` in material.c.
+typedef struct MaterialDefinition {
+    CMaterial material;
+    const char *name;
+    CType type;    // What cells of the material are, including those it reacts into.
+    int maxState;  // Most state a cell holds before it pushes state into the cell above. At most 255.
+    int flowRate;  // Most state a cell spreads into each side in a step. At most 255.
+    Color color;   // Colour of a cell with no state, which darkens as the state grows.
+} MaterialDefinition;
+
+// A cell of `material` next to a cell of `reactant` turns into `result`, keeping its state. A material may react with
+// several others, in which case the first of its reactions with a reactant around it wins.
+typedef struct Reaction {
+    CMaterial material;
+    CMaterial reactant;
+    CMaterial result;
+} Reaction;
+
+// The definitions and reactions compiled into tables indexed by material, so the rules and kernels look up how a cell
+// behaves rather than branching on its material. The byte tables are 16 bytes, which the vector kernels look up with a
+// single shuffle.
+typedef struct MaterialTables {
+    uint8_t maxState[MATERIAL_SLOTS];
+    uint8_t flowRate[MATERIAL_SLOTS];
+    Color colors[MATERIAL_SLOTS];
+    MaterialSet reactants[MATERIAL_SLOTS]; // Materials each material reacts with.
+    uint8_t reactionCount[MATERIAL_SLOTS];
+    uint8_t reactionReactants[MATERIAL_SLOTS][MATERIAL_MAX_REACTIONS];
+    uint8_t reactionKinds[MATERIAL_SLOTS][MATERIAL_MAX_REACTIONS]; // `kind` of the cell once it has reacted.
+} MaterialTables;
+
+const MaterialTables *getMaterials();
+const char *materialName(CMaterial material);
+
+#endif // ptest_material_h
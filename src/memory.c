@@ -1,4 +1,7 @@
 #include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 #include "memory.h"
 
@@ -23,3 +26,31 @@ void *reallocate(void *pointer, size_t oldSize, size_t newSize) {
 
     return result;
 }
+
+// Allocate `size` bytes aligned to `alignment`, which must be a power of two multiple of `sizeof(void *)`. Memory
+// allocated with this must be released with `freeAligned`, and cannot be grown with `reallocate`.
+void *allocateAligned(size_t alignment, size_t size) {
+#ifdef _WIN32
+    void *result = _aligned_malloc(size, alignment);
+#else
+    void *result = NULL;
+    if (posix_memalign(&result, alignment, size) != 0) {
+        result = NULL;
+    }
+#endif
+
+    if (result == NULL) {
+        // Memory has ran out!
+        exit(1);
+    }
+
+    return result;
+}
+
+void freeAligned(void *pointer) {
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    free(pointer);
+#endif
+}
@@ -17,7 +17,16 @@
 
 #define FREE_ARRAY(type, pointer, oldCount) reallocate(pointer, sizeof(type) * (oldCount), 0);
 
+// Size in bytes of a cache line. Large arrays which are swept every frame are aligned to this.
+#define CACHE_LINE_SIZE 64
+
+#define ALLOCATE_ALIGNED(type, count) (type *)allocateAligned(CACHE_LINE_SIZE, sizeof(type) * (count))
+
+#define FREE_ALIGNED(pointer) freeAligned(pointer)
+
 void *reallocate(void *pointer, size_t oldSize, size_t newSize);
+void *allocateAligned(size_t alignment, size_t size);
+void freeAligned(void *pointer);
 void freeObjects();
 
 #endif // !ptest_memory_h
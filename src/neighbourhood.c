@@ -1,6 +1,7 @@
 
 #include "neighbourhood.h"
 #include "debug.h"
+#include "material.h"
 #include "value.h"
 
 CellNeighbourhood newCellNeighbourhood(CellValue *nw, CellValue *n, CellValue *ne, CellValue *w, CellValue *c,
@@ -20,14 +21,16 @@ CellNeighbourhood newCellNeighbourhood(CellValue *nw, CellValue *n, CellValue *n
 
 static bool canFlow(CellValue source) { return isFluid(source) && source.state > 0; }
 
-#define MAX_FLUID_STATE 64
-#define MAX_FLOW 4
-static bool canFallTo(CellValue source, CellValue destination) {
+// How much state a cell of the material of `source` holds before pushing into the cell above, and spreads to each side
+static int maxState(const MaterialTables *tables, CellValue source) { return tables->maxState[CELL_MATERIAL(source)]; }
+static int flowRate(const MaterialTables *tables, CellValue source) { return tables->flowRate[CELL_MATERIAL(source)]; }
+
+static bool canFallTo(const MaterialTables *tables, CellValue source, CellValue destination) {
     if (canFlow(source)) {
         if (isEmpty(destination))
             return true;
         if (isFluid(destination)) {
-            return source.material == destination.material && destination.state < MAX_FLUID_STATE;
+            return CELL_MATERIAL(source) == CELL_MATERIAL(destination) && destination.state < maxState(tables, source);
         }
     }
     return false;
@@ -38,152 +41,155 @@ static bool canFlowTo(CellValue source, CellValue destination) {
         if (isEmpty(destination))
             return true;
         if (isFluid(destination)) {
-            return source.material == destination.material && destination.state < source.state;
+            return CELL_MATERIAL(source) == CELL_MATERIAL(destination) && destination.state < source.state;
         }
     }
 
     return false;
 }
 
-static int constrain(int x) { return x <= MAX_FLOW ? x : MAX_FLOW; }
+static int constrain(const MaterialTables *tables, CellValue source, int x) {
+    return x <= flowRate(tables, source) ? x : flowRate(tables, source);
+}
 
-static bool isOverPressurised(CellValue source, CellValue destination) { return source.state > MAX_FLUID_STATE; }
+static bool isOverPressurised(const MaterialTables *tables, CellValue source, CellValue destination) {
+    return source.state > maxState(tables, source);
+}
 
-static int resolvePressureDifference(CellValue source, CellValue destination) { return source.state - MAX_FLUID_STATE; }
+static int resolvePressureDifference(const MaterialTables *tables, CellValue source, CellValue destination) {
+    return source.state - maxState(tables, source);
+}
 
-int surroundingSum(CellNeighbourhood n) {
-    return n.nw->occ.se + n.n->occ.s + n.ne->occ.sw + n.w->occ.e + +n.c->occ.c + n.e->occ.w + n.sw->occ.ne +
-           n.s->occ.n + n.se->occ.nw;
+// `inflow` holds the occupation flowing into the centre from each neighbour. For example `inflow.nw` is the south east
+// component of the north west cell's occupation number.
+int surroundingSum(OccupationNumber inflow) {
+    return inflow.nw + inflow.n + inflow.ne + inflow.w + inflow.c + inflow.e + inflow.sw + inflow.s + inflow.se;
 }
 
-CMaterial determineMaterial(CellNeighbourhood n) {
-    if (n.nw->occ.se != 0)
-        return n.nw->material;
-    if (n.n->occ.s != 0)
-        return n.n->material;
-    if (n.ne->occ.sw != 0)
-        return n.ne->material;
-    if (n.w->occ.e != 0)
-        return n.w->material;
-    if (n.c->occ.c != 0)
-        return n.c->material;
-    if (n.e->occ.w != 0)
-        return n.e->material;
-    if (n.sw->occ.ne != 0)
-        return n.sw->material;
-    if (n.s->occ.n != 0)
-        return n.s->material;
-    if (n.se->occ.nw != 0)
-        return n.se->material;
+// Returns the material of the first neighbour with fluid flowing into the centre.
+CMaterial determineMaterial(CellNeighbourhood n, OccupationNumber inflow) {
+    if (inflow.nw != 0)
+        return CELL_MATERIAL(*n.nw);
+    if (inflow.n != 0)
+        return CELL_MATERIAL(*n.n);
+    if (inflow.ne != 0)
+        return CELL_MATERIAL(*n.ne);
+    if (inflow.w != 0)
+        return CELL_MATERIAL(*n.w);
+    if (inflow.c != 0)
+        return CELL_MATERIAL(*n.c);
+    if (inflow.e != 0)
+        return CELL_MATERIAL(*n.e);
+    if (inflow.sw != 0)
+        return CELL_MATERIAL(*n.sw);
+    if (inflow.s != 0)
+        return CELL_MATERIAL(*n.s);
+    if (inflow.se != 0)
+        return CELL_MATERIAL(*n.se);
 
     return NONE;
 }
 
-OccupationNumber collide(CellNeighbourhood n) {
+// `tables` are the compiled material tables, looked up once by the caller rather than for every cell.
+OccupationNumber collide(const MaterialTables *tables, CellNeighbourhood n) {
     OccupationNumber occ;
     initOccupationNumber(&occ);
-    int originalState = n.c->state;
-    if (n.c->type != FLUID) {
+    if (!isFluid(*n.c)) {
         return occ;
     }
     occ.c = n.c->state;
 
+    // The centre loses state as it flows out. Work on a copy so the grid is only ever read.
+    CellValue c = *n.c;
+
     int diff = 0;
-    if (canFallTo(*n.c, *n.s)) {
-        int maxFlow = MAX_FLUID_STATE - n.s->state;
-        maxFlow = maxFlow < n.c->state ? maxFlow : n.c->state;
-        diff = difference(*n.c, *n.s);
+    if (canFallTo(tables, c, *n.s)) {
+        int maxFlow = maxState(tables, c) - n.s->state;
+        maxFlow = maxFlow < c.state ? maxFlow : c.state;
+        diff = difference(c, *n.s);
         occ.s = diff > 0 ? diff : -diff;
         occ.s = occ.s > maxFlow ? maxFlow : occ.s;
         occ.c -= occ.s;
-        n.c->state -= occ.s;
+        c.state -= occ.s;
     }
-    if (canFallTo(*n.c, *n.sw)) {
-        int maxFlow = MAX_FLUID_STATE - n.sw->state;
-        maxFlow = maxFlow < n.c->state ? maxFlow : n.c->state;
-        diff = difference(*n.c, *n.sw);
+    if (canFallTo(tables, c, *n.sw)) {
+        int maxFlow = maxState(tables, c) - n.sw->state;
+        maxFlow = maxFlow < c.state ? maxFlow : c.state;
+        diff = difference(c, *n.sw);
         occ.sw = diff > 0 ? diff : -diff;
         occ.sw = occ.sw > maxFlow ? maxFlow : occ.sw;
         occ.c -= occ.sw;
-        n.c->state -= occ.sw;
+        c.state -= occ.sw;
     }
-    if (canFallTo(*n.c, *n.se)) {
-        int maxFlow = MAX_FLUID_STATE - n.se->state;
-        maxFlow = maxFlow < n.c->state ? maxFlow : n.c->state;
-        diff = difference(*n.c, *n.se);
+    if (canFallTo(tables, c, *n.se)) {
+        int maxFlow = maxState(tables, c) - n.se->state;
+        maxFlow = maxFlow < c.state ? maxFlow : c.state;
+        diff = difference(c, *n.se);
         occ.se = diff > 0 ? diff : -diff;
         occ.se = occ.sw > maxFlow ? maxFlow : occ.sw;
         occ.c -= occ.se;
-        n.c->state -= occ.se;
+        c.state -= occ.se;
     }
-    if (canFlowTo(*n.c, *n.w)) {
-        diff = difference(*n.c, *n.w);
-        occ.w = constrain(diff / 2);
+    if (canFlowTo(c, *n.w)) {
+        diff = difference(c, *n.w);
+        occ.w = constrain(tables, c, diff / 2);
         occ.c -= occ.w;
-        n.c->state -= occ.w;
+        c.state -= occ.w;
     }
-    if (canFlowTo(*n.c, *n.e)) {
-        diff = difference(*n.c, *n.e);
-        occ.e = constrain(diff / 2);
+    if (canFlowTo(c, *n.e)) {
+        diff = difference(c, *n.e);
+        occ.e = constrain(tables, c, diff / 2);
         occ.c -= occ.e;
-        n.c->state -= occ.e;
+        c.state -= occ.e;
     }
-    if (canFlowTo(*n.c, *n.n) && isOverPressurised(*n.c, *n.n)) {
-        occ.n = resolvePressureDifference(*n.c, *n.n);
+    if (canFlowTo(c, *n.n) && isOverPressurised(tables, c, *n.n)) {
+        occ.n = resolvePressureDifference(tables, c, *n.n);
         occ.c -= occ.n;
     }
 
-    if (n.c->state < occ.c) {
-        LogMessage(LOG_ERROR, "Center state grew: %d -> %d", n.c->state, occ.c);
+    if (c.state < occ.c) {
+        LogMessage(LOG_ERROR, "Center state grew: %d -> %d", c.state, occ.c);
     }
 
-    n.c->state = originalState;
-
     // LogMessage(LOG_INFO, "OccupationNumber calculated to: nw: %d, n : %d, ne : %d, w : %d, c : %d, e : %d, sw : %d, s
     // : %d, se : %d", occ.nw, occ.n, occ.ne, occ.w, occ.c, occ.e, occ.sw, occ.s, occ.se);
 
     return occ;
 }
 
-static bool materialInSurrounding(CellNeighbourhood n, CMaterial material) {
-    return n.nw->material == material || n.n->material == material || n.ne->material == material ||
-           n.w->material == material || n.e->material == material || n.sw->material == material ||
-           n.s->material == material || n.se->material == material;
+static MaterialSet materialsInSurrounding(CellNeighbourhood n) {
+    return MATERIAL_BIT(CELL_MATERIAL(*n.nw)) | MATERIAL_BIT(CELL_MATERIAL(*n.n)) | MATERIAL_BIT(CELL_MATERIAL(*n.ne)) |
+           MATERIAL_BIT(CELL_MATERIAL(*n.w)) | MATERIAL_BIT(CELL_MATERIAL(*n.e)) | MATERIAL_BIT(CELL_MATERIAL(*n.sw)) |
+           MATERIAL_BIT(CELL_MATERIAL(*n.s)) | MATERIAL_BIT(CELL_MATERIAL(*n.se));
 }
 
-typedef struct Reaction {
-    CMaterial reactant;
-    CType type;
-    CMaterial result;
-} Reaction;
-
-// clang-format off
-const Reaction reactions[] = {
-    [NONE]  = { NONE,  VACUUM, NONE },
-    [AIR]   = { NONE,  VACUUM, NONE },
-    [WATER] = { NONE,  VACUUM, NONE },
-    [LAVA]  = { WATER, SOLID,  STONE },
-    [STONE] = { NONE,  VACUUM, NONE },
-};
-// clang-format on
-
-static bool getReaction(CMaterial material, Reaction *reaction) {
-    if (reactions[material].reactant != NONE) {
-        *reaction = reactions[material];
-        return true;
+// Returns `true` if any of `materials` reacts with another of them. Cells only ever react next to their reactant, so
+// when this is `false` for every material in reach of an area, none of it can react and `react` can be skipped there.
+bool canReact(MaterialSet materials) {
+    const MaterialTables *tables = getMaterials();
+    for (int material = 0; material < MATERIAL_SLOTS; material++) {
+        if ((materials & MATERIAL_BIT(material)) && (materials & tables->reactants[material])) {
+            return true;
+        }
     }
     return false;
 }
 
-CellValue react(CellNeighbourhood n) {
-    Reaction reaction;
-    if (getReaction(n.c->material, &reaction)) {
-        if (materialInSurrounding(n, reaction.reactant)) {
-            return newCellValue(reaction.type, reaction.result, n.c->state);
-        }
+CellValue react(const MaterialTables *tables, CellNeighbourhood n) {
+    CMaterial material = CELL_MATERIAL(*n.c);
+    if (tables->reactants[material] == 0) {
+        return *n.c;
+    }
+
+    MaterialSet around = materialsInSurrounding(n);
+    if ((around & tables->reactants[material]) == 0) {
+        return *n.c;
     }
 
+    for (int i = 0; i < tables->reactionCount[material]; i++) {
+        if (around & MATERIAL_BIT(tables->reactionReactants[material][i])) {
+            return (CellValue){tables->reactionKinds[material][i], 0, n.c->state};
+        }
+    }
     return *n.c;
 }
-#undef MAX_FLUID_STATE
-#undef MAX_FLOW
@@ -1,6 +1,7 @@
 #ifndef ptest_neighbourhood_h
 #define ptest_neighbourhood_h
 
+#include "material.h"
 #include "value.h"
 
 typedef struct CellNeighbourhood {
@@ -17,9 +18,10 @@ typedef struct CellNeighbourhood {
 
 CellNeighbourhood newCellNeighbourhood(CellValue *nw, CellValue *n, CellValue *ne, CellValue *w, CellValue *c,
                                        CellValue *e, CellValue *sw, CellValue *s, CellValue *se);
-OccupationNumber collide(CellNeighbourhood n);
-int surroundingSum(CellNeighbourhood n);
-CMaterial determineMaterial(CellNeighbourhood n);
-CellValue react(CellNeighbourhood n);
+OccupationNumber collide(const MaterialTables *tables, CellNeighbourhood n);
+int surroundingSum(OccupationNumber inflow);
+CMaterial determineMaterial(CellNeighbourhood n, OccupationNumber inflow);
+bool canReact(MaterialSet materials);
+CellValue react(const MaterialTables *tables, CellNeighbourhood n);
 
 #endif // ptest_neighbourhood_h
@@ -10,6 +10,7 @@
 #include "memory.h"
 #include "quadtree.h"
 #include "raymath.h"
+#include "slab.h"
 #include "table.h"
 
 typedef enum Quadrant {
@@ -20,10 +21,84 @@ typedef enum Quadrant {
 } Quadrant;
 
 Table quadtrees;
+static QuadTreeStats stats;
+// Interned trees are allocated from their own slab, so trees stepped together sit together in memory, and are named
+// by their handle in it.
+static Slab nodes;
+// The values in the quadrants of trees of depth 1.
+static LeafTable leaves;
+
+// A leap result memoized on a tree, for one step size. The memos of a tree are listed from its `leaps`, by their
+// handle in their own slab, and there is at most one for each step size the tree can leap, so at most `depth - 3`.
+typedef struct LeapMemo {
+    QuadTreeRef result; // Centre of the tree after `1 << log2Steps` steps of the rule.
+    SlabHandle next;    // The next memo of the same tree, or SLAB_NO_HANDLE.
+    uint8_t log2Steps;
+} LeapMemo;
+
+static Slab memos;
+
+// Places outside this file holding trees that must survive a collection, such as the root being shown.
+static QuadTree ***roots = NULL;
+static int rootCount = 0;
+static int rootCapacity = 0;
+
+// Bytes of trees there can be before the next collection.
+static size_t nextCollect = QUADTREE_GC_THRESHOLD;
 
 // QuadTree table
-void printTreeTable() { tablePrint(&quadtrees); }
-void initQuadTable() { initTable(&quadtrees); }
+void printTreeTable() {
+    tablePrint(&quadtrees);
+    logSlabStats(&nodes, "quadtree nodes");
+    logSlabStats(&memos, "leap memos");
+    LogMessage(LOG_INFO, "Leaves: %d distinct values", leaves.count);
+
+    QuadTreeStats current = quadTreeStats();
+    LogMessage(LOG_INFO, "Evolve memo hits: %lu / %lu, leap memo hits: %lu / %lu", current.evolveHits,
+               current.evolveCalls, current.leapHits, current.leapCalls);
+    LogMessage(LOG_INFO, "Intern lookups: %lu, probes: %lu (longest %lu), hash collisions: %lu", current.internLookups,
+               current.internProbes, current.longestProbe, current.internCollisions);
+    LogMessage(LOG_INFO, "Collections: %lu, trees freed: %lu", current.collections, current.treesFreed);
+}
+void initQuadTable() {
+    initTable(&quadtrees);
+    initSlab(&nodes, sizeof(QuadTree));
+    initSlab(&memos, sizeof(LeapMemo));
+    initLeafTable(&leaves);
+}
+
+QuadTreeStats quadTreeStats() {
+    QuadTreeStats current = stats;
+    current.internLookups = quadtrees.lookups;
+    current.internProbes = quadtrees.probes;
+    current.internCollisions = quadtrees.collisions;
+    current.longestProbe = quadtrees.longestProbe;
+    current.leaves = leaves.count;
+    return current;
+}
+
+void resetQuadTreeStats() {
+    stats = (QuadTreeStats){0};
+    tableResetStats(&quadtrees);
+}
+
+void addQuadTreeRoot(QuadTree **root) {
+    if (rootCount + 1 > rootCapacity) {
+        int oldCapacity = rootCapacity;
+        rootCapacity = GROW_CAPACITY(oldCapacity);
+        roots = GROW_ARRAY(QuadTree **, roots, oldCapacity, rootCapacity);
+    }
+    roots[rootCount++] = root;
+}
+
+void removeQuadTreeRoot(QuadTree **root) {
+    for (int i = 0; i < rootCount; i++) {
+        if (roots[i] == root) {
+            roots[i] = roots[--rootCount];
+            return;
+        }
+    }
+}
 
 // Quadrant
 static Quadrant pointToQuadrant(Vector2 point, Vector2 center) {
@@ -41,7 +116,7 @@ static Quadrant pointToQuadrant(Vector2 point, Vector2 center) {
     return NE;
 }
 
-static QuadrantValue quadrantGet(Quadrant quadrant, const QuadTree *quadtree) {
+static QuadTreeRef quadrantGet(Quadrant quadrant, const QuadTree *quadtree) {
     switch (quadrant) {
     case NW:
         return quadtree->NW;
@@ -54,7 +129,7 @@ static QuadrantValue quadrantGet(Quadrant quadrant, const QuadTree *quadtree) {
     }
 }
 
-static void quadrantSet(Quadrant quadrant, QuadTree *quadtree, QuadrantValue value) {
+static void quadrantSet(Quadrant quadrant, QuadTree *quadtree, QuadTreeRef value) {
     switch (quadrant) {
     case NW:
         quadtree->NW = value;
@@ -72,20 +147,29 @@ static void quadrantSet(Quadrant quadrant, QuadTree *quadtree, QuadrantValue val
 }
 
 // Hashing
-static int hashQvalue(QuadrantValue qvalue) {
+
+// Hashes every field of the value along with its type, so values that only differ in one field hash apart. Trees are
+// interned, so their own hash identifies them.
+static uint64_t hashQvalue(QuadrantValue qvalue) {
+    uint64_t type = (uint64_t)qvalue.type << 56;
     switch (qvalue.type) {
 
     case VAL_INT:
-        return hash_6432shift(AS_INT(qvalue));
+        return hash_mix64(type | (uint32_t)AS_INT(qvalue));
     case VAL_FLUID: {
         FluidValue fluid = AS_FLUID(qvalue);
-        return hash_6432shift(fluid.type + fluid.state);
+        return hash_mix64(type | (uint64_t)(fluid.type & 0xFF) << 32 | (uint32_t)fluid.state);
     }
     case VAL_TREE:
-        return hash_ptr(AS_QUADTREE(qvalue));
+        return AS_QUADTREE(qvalue) != NULL ? AS_QUADTREE(qvalue)->hash : 0;
     case VAL_OCCUPATION: {
         QOccupationNumber occ = AS_OCCUPATION_NUMBER(qvalue);
-        return hash_6432shift(occ.nw + occ.n + occ.ne + occ.w + occ.e + occ.sw + occ.s + occ.se);
+        int flows[] = {occ.nw, occ.n, occ.ne, occ.w, occ.c, occ.e, occ.sw, occ.s, occ.se};
+        uint64_t hash = hash_mix64(type);
+        for (int i = 0; i < 9; i++) {
+            hash = hash_combine64(hash, (uint32_t)flows[i]);
+        }
+        return hash;
     }
     case VAL_EMPTY:
         // Should never really be reached. We should not have an empty node in the tree
@@ -93,14 +177,27 @@ static int hashQvalue(QuadrantValue qvalue) {
     }
 }
 
-static int hashQuadrants(QuadrantValue nw, QuadrantValue ne, QuadrantValue sw, QuadrantValue se) {
-    return hashQvalue(nw) + 2 * hashQvalue(ne) + 4 * hashQvalue(sw) + 8 * hashQvalue(se);
+static QuadTree *treeAt(QuadTreeRef ref) { return slabObject(&nodes, ref); }
+
+static QuadrantValue leafAt(QuadTreeRef ref) { return leaves.leaves[ref].value; }
+
+static LeapMemo *memoAt(SlabHandle handle) { return slabObject(&memos, handle); }
+
+// Hash of a quadrant of a tree of depth `depth`, which is a leaf for trees of depth 1 and a tree otherwise.
+static uint64_t hashQuadrant(int depth, QuadTreeRef ref) {
+    return depth == 1 ? leaves.leaves[ref].hash : treeAt(ref)->hash;
 }
 
-static int hashQuadTree(const QuadTree *quadtree) {
-    return hashQuadrants(quadtree->NW, quadtree->NE, quadtree->SW, quadtree->SE);
+static uint64_t hashQuadrants(int depth, QuadTreeRef nw, QuadTreeRef ne, QuadTreeRef sw, QuadTreeRef se) {
+    uint64_t hash = hashQuadrant(depth, nw);
+    hash = hash_combine64(hash, hashQuadrant(depth, ne));
+    hash = hash_combine64(hash, hashQuadrant(depth, sw));
+    return hash_combine64(hash, hashQuadrant(depth, se));
 }
 
+// Returns the index of `qvalue` in the leaf table, adding it if it is new.
+static QuadTreeRef internLeaf(QuadrantValue qvalue) { return leafTableIntern(&leaves, qvalue, hashQvalue(qvalue)); }
+
 // FluidValues's
 static FluidValue newFluidValue(FluidType type, int state) { return (FluidValue){.type = type, .state = state}; }
 
@@ -130,7 +227,7 @@ static void logQuadrantValue(TraceLogLevel level, const char *message, QuadrantV
 }
 
 // Compare two `QuadrantValue`'s.
-static bool compare(QuadrantValue left, QuadrantValue right) {
+bool quadrantValuesEqual(QuadrantValue left, QuadrantValue right) {
     if (left.type != right.type) {
         return false;
     }
@@ -165,11 +262,12 @@ static bool isEmpty(QuadrantValue qvalue) { return IS_INT(qvalue) && AS_INT(qval
 
 // QuadTrees
 
-// Allocate a quadtree on the heap with the given quadrant values
-static QuadTree *allocateQuadTree(QuadrantValue nw, QuadrantValue ne, QuadrantValue sw, QuadrantValue se, int depth,
-                                  uint32_t hash) {
-    QuadTree *quadtree = (QuadTree *)reallocate(NULL, 0, sizeof(QuadTree));
+// Allocate a quadtree in the node slab with the given quadrants, and intern it.
+static QuadTreeRef allocateQuadTree(QuadTreeRef nw, QuadTreeRef ne, QuadTreeRef sw, QuadTreeRef se, int depth,
+                                    uint64_t hash) {
+    QuadTree *quadtree = slabAllocate(&nodes);
     quadtree->depth = depth;
+    quadtree->isMarked = false;
 
     quadtree->NW = nw;
     quadtree->NE = ne;
@@ -177,87 +275,70 @@ static QuadTree *allocateQuadTree(QuadrantValue nw, QuadrantValue ne, QuadrantVa
     quadtree->SE = se;
 
     quadtree->hash = hash;
+    quadtree->ref = slabHandle(&nodes, quadtree);
 
-    quadtree->result = NULL;
+    quadtree->result = QUADTREE_NONE;
+    quadtree->leaps = SLAB_NO_HANDLE;
 
     tableSet(&quadtrees, hash, quadtree);
 
-    return quadtree;
+    return quadtree->ref;
 }
 
-// Attempts to copy the tree the the heap. Returns the interned tree if it already exists.
-static QuadTree *copyQuadTree(QuadTree *quadtree) {
-    QuadTree *interned = tableFindQuadTree(&quadtrees, quadtree, quadtree->hash);
-    if (interned == NULL) {
-        interned =
-            allocateQuadTree(quadtree->NW, quadtree->NE, quadtree->SW, quadtree->SE, quadtree->depth, quadtree->hash);
-    }
-
-    return interned;
-}
-
-// Returns `true` if the quadtrees have the same values inside. Two `QuadTree` values are the same if they have the same
-// pointer.
+// Returns `true` if the quadtrees have the same quadrants. Quadrants are interned, so they are the same if they have
+// the same handle.
 bool quadtreesEqual(const QuadTree *left, const QuadTree *right) {
-    if (left->depth != right->depth || !isSubdivided(*left) || !isSubdivided(*right)) {
-        return false;
-    }
-    return compare(left->NW, right->NW) && compare(left->NE, right->NE) && compare(left->SW, right->SW) &&
-           compare(left->SE, right->SE);
+    return left->depth == right->depth && left->NW == right->NW && left->NE == right->NE && left->SW == right->SW &&
+           left->SE == right->SE;
 }
 
-bool isSubdivided(QuadTree quadtree) { return !IS_QUADTREE(quadtree.NE) || AS_QUADTREE(quadtree.NE) != NULL; }
-
-static QuadTree leafNode(int nw, int ne, int sw, int se) {
-    QuadTree quadtree =
-        (QuadTree){.depth = 1, .NW = INT_VALUE(nw), .NE = INT_VALUE(ne), .SW = INT_VALUE(sw), .SE = INT_VALUE(se)};
-    quadtree.hash = hashQuadrants(INT_VALUE(nw), INT_VALUE(ne), INT_VALUE(sw), INT_VALUE(se));
-    quadtree.result = NULL;
-    return quadtree;
-}
-
-static bool isLeaf(QuadrantValue qvalue) { return IS_INT(qvalue) || IS_FLUID(qvalue); }
-
-static QuadTree treeNode(int depth, const QuadTree *nw, const QuadTree *ne, const QuadTree *sw, const QuadTree *se) {
-    QuadTree quadtree = (QuadTree){.depth = depth,
-                                   .NW = QUADTREE_VALUE(nw),
-                                   .NE = QUADTREE_VALUE(ne),
-                                   .SW = QUADTREE_VALUE(sw),
-                                   .SE = QUADTREE_VALUE(se)};
-    quadtree.hash = hashQuadrants(QUADTREE_VALUE(nw), QUADTREE_VALUE(ne), QUADTREE_VALUE(sw), QUADTREE_VALUE(se));
-    quadtree.result = NULL;
-    return quadtree;
-}
-
-static bool isTreeNode(QuadrantValue qvalue) { return IS_QUADTREE(qvalue); }
-
-// Returns the interned node with the given values. Creates the interned node if it does not exist.
-static QuadTree *node(int depth, QuadrantValue nw, QuadrantValue ne, QuadrantValue sw, QuadrantValue se) {
+// Returns the interned node with the given quadrants. Creates the interned node if it does not exist.
+static QuadTreeRef node(int depth, QuadTreeRef nw, QuadTreeRef ne, QuadTreeRef sw, QuadTreeRef se) {
     QuadTree quadtree = (QuadTree){.depth = depth, .NW = nw, .NE = ne, .SW = sw, .SE = se};
-    quadtree.hash = hashQuadrants(nw, ne, sw, se);
-    quadtree.result = NULL;
+    uint64_t hash = hashQuadrants(depth, nw, ne, sw, se);
 
-    return copyQuadTree(&quadtree);
+    QuadTree *interned = tableFindQuadTree(&quadtrees, &quadtree, hash);
+    if (interned != NULL) {
+        return interned->ref;
+    }
+    return allocateQuadTree(nw, ne, sw, se, depth, hash);
 }
 
-// Creates a quadtree with a constant value throughout
-static QuadTree *newConstantQuadTree(int depth, int x) {
-    QuadTree baseLeaf = leafNode(x, x, x, x);
+static QuadTreeRef leafNode(int nw, int ne, int sw, int se) {
+    return node(1, internLeaf(INT_VALUE(nw)), internLeaf(INT_VALUE(ne)), internLeaf(INT_VALUE(sw)),
+                internLeaf(INT_VALUE(se)));
+}
 
-    // Check if the empty leaf is already interned
-    QuadTree *quadtree = copyQuadTree(&baseLeaf);
+// Empty trees by depth, built the first time each depth is needed so padding and checking for empty space never go
+// through the table. Slot 0 is unused, as the shallowest tree is a leaf of depth 1.
+static QuadTreeRef *emptyTrees = NULL;
+static int emptyTreesCount = 0;
+static int emptyTreesCapacity = 0;
+
+static QuadTreeRef emptyTree(int depth) {
+    while (emptyTreesCount <= depth) {
+        if (emptyTreesCount + 1 > emptyTreesCapacity) {
+            int oldCapacity = emptyTreesCapacity;
+            emptyTreesCapacity = GROW_CAPACITY(oldCapacity);
+            emptyTrees = GROW_ARRAY(QuadTreeRef, emptyTrees, oldCapacity, emptyTreesCapacity);
+        }
 
-    // Building the empty nodes from the leaf node upwards until the tree is full
-    for (int i = 2; i <= depth; i++) {
-        QuadTree newTree = treeNode(i, quadtree, quadtree, quadtree, quadtree);
-        quadtree = copyQuadTree(&newTree);
+        int level = emptyTreesCount;
+        if (level == 0) {
+            emptyTrees[level] = QUADTREE_NONE;
+        } else if (level == 1) {
+            emptyTrees[level] = leafNode(0, 0, 0, 0);
+        } else {
+            QuadTreeRef below = emptyTrees[level - 1];
+            emptyTrees[level] = node(level, below, below, below, below);
+        }
+        emptyTreesCount++;
     }
-
-    return quadtree;
+    return emptyTrees[depth];
 }
 
 // We will set 0 to be the lowest depth (leafs)
-QuadTree *newEmptyQuadTree(int depth) { return newConstantQuadTree(depth, 0); }
+QuadTree *newEmptyQuadTree(int depth) { return treeAt(emptyTree(depth)); }
 
 static Vector2 centerOfQuadrant(Quadrant quadrant, Vector2 center, float width) {
     switch (quadrant) {
@@ -278,30 +359,25 @@ QuadTree *setPointInQuadTree(Vector2 point, Vector2 center, float width, const Q
                              QuadrantValue value) {
     // Find the quadrant the point is located in
     Quadrant quadrant = pointToQuadrant(point, center);
-    QuadrantValue qvalue = quadrantGet(quadrant, quadtree);
+    QuadTreeRef ref = quadrantGet(quadrant, quadtree);
 
-    QuadTree copy;
-    if (isLeaf(qvalue)) {
-        // Base Case - This quadtree is a leaf node, and qvalue is an integer
-        copy = *quadtree;
-        QuadrantValue newValue = AS_INT(value) == -1 ? flip(quadrantGet(quadrant, &copy)) : value;
+    QuadTree copy = *quadtree;
+    if (quadtree->depth == 1) {
+        // Base Case - This quadtree is a leaf node, and its quadrant is a leaf value
+        QuadrantValue newValue = AS_INT(value) == -1 ? flip(leafAt(ref)) : value;
 
         // TODO: We use -1 to represent a flip. Integer overflow will cause a problem?
-        quadrantSet(quadrant, &copy, newValue);
+        quadrantSet(quadrant, &copy, internLeaf(newValue));
     } else {
         // Recursively go down until at a leaf
         center = centerOfQuadrant(quadrant, center, width / 2.0f);
         width /= 2;
 
-        QuadTree *subTree = setPointInQuadTree(point, center, width, AS_QUADTREE(qvalue), value);
-        copy = *quadtree;
-        quadrantSet(quadrant, &copy, QUADTREE_VALUE(subTree));
+        QuadTree *subTree = setPointInQuadTree(point, center, width, treeAt(ref), value);
+        quadrantSet(quadrant, &copy, subTree->ref);
     }
 
-    // Need to rehash as the quadtree has been altered
-    copy.hash = hashQuadTree(&copy);
-
-    return copyQuadTree(&copy);
+    return treeAt(node(copy.depth, copy.NW, copy.NE, copy.SW, copy.SE));
 }
 
 // Drawing
@@ -319,23 +395,39 @@ static void drawFluid(FluidValue fluid, int x, int y, float width, float height)
     DrawText(TextFormat("%d", fluid.state), x, y, 16, WHITE);
 }
 
-static void drawQuadrantValue(QuadrantValue qvalue, int x, int y, float width, float height);
+static void drawQuadrantValue(QuadrantValue qvalue, int x, int y, float width, float height, Rectangle view);
 
-static void drawTree(QuadTree *quadtree, int x, int y, float width, float height) {
-    Vector2 center = centerOfQuadrant(NW, (Vector2){x, y}, width);
-    drawQuadrantValue(quadtree->NW, center.x, center.y, width / 2.0f, height / 2.0f);
+static void drawTree(const QuadTree *quadtree, float x, float y, float width, float height, Rectangle view);
 
-    center = centerOfQuadrant(NE, (Vector2){x, y}, width);
-    drawQuadrantValue(quadtree->NE, center.x, center.y, width / 2.0f, height / 2.0f);
+static void drawQuadrant(const QuadTree *quadtree, Quadrant quadrant, float x, float y, float width, float height,
+                         Rectangle view) {
+    Vector2 center = centerOfQuadrant(quadrant, (Vector2){x, y}, width);
+    QuadTreeRef ref = quadrantGet(quadrant, quadtree);
+    if (quadtree->depth == 1) {
+        drawQuadrantValue(leafAt(ref), center.x, center.y, width / 2.0f, height / 2.0f, view);
+    } else {
+        drawTree(treeAt(ref), center.x, center.y, width / 2.0f, height / 2.0f, view);
+    }
+}
 
-    center = centerOfQuadrant(SW, (Vector2){x, y}, width);
-    drawQuadrantValue(quadtree->SW, center.x, center.y, width / 2.0f, height / 2.0f);
+// Draws the tree centred on `x`, `y` reaching `width` and `height` either side. Trees outside `view` and empty ones
+// draw nothing, so are skipped without looking inside them, which keeps a large root with little in it cheap to draw.
+static void drawTree(const QuadTree *quadtree, float x, float y, float width, float height, Rectangle view) {
+    if (x + width < view.x || x - width > view.x + view.width || y + height < view.y ||
+        y - height > view.y + view.height) {
+        return;
+    }
+    if (quadtree->ref == emptyTree(quadtree->depth)) {
+        return;
+    }
 
-    center = centerOfQuadrant(SE, (Vector2){x, y}, width);
-    drawQuadrantValue(quadtree->SE, center.x, center.y, width / 2.0f, height / 2.0f);
+    drawQuadrant(quadtree, NW, x, y, width, height, view);
+    drawQuadrant(quadtree, NE, x, y, width, height, view);
+    drawQuadrant(quadtree, SW, x, y, width, height, view);
+    drawQuadrant(quadtree, SE, x, y, width, height, view);
 }
 
-static void drawQuadrantValue(QuadrantValue qvalue, int x, int y, float width, float height) {
+static void drawQuadrantValue(QuadrantValue qvalue, int x, int y, float width, float height, Rectangle view) {
     switch (qvalue.type) {
     case VAL_INT:
         drawInt(AS_INT(qvalue), x, y, width, height);
@@ -344,7 +436,7 @@ static void drawQuadrantValue(QuadrantValue qvalue, int x, int y, float width, f
         drawFluid(AS_FLUID(qvalue), x, y, width, height);
         break;
     case VAL_TREE:
-        drawTree(AS_QUADTREE(qvalue), x, y, width, height);
+        drawTree(AS_QUADTREE(qvalue), x, y, width, height, view);
         break;
     case VAL_OCCUPATION: {
         QOccupationNumber occ = AS_OCCUPATION_NUMBER(qvalue);
@@ -368,19 +460,23 @@ static void drawQuadrantValue(QuadrantValue qvalue, int x, int y, float width, f
     }
 }
 
+// Draws the part of `quadtree` seen through `camera`.
 void drawQuadTree(QuadTree quadtree, Vector2 center, float width, Camera2D camera) {
-    drawTree(&quadtree, center.x, center.y, width / 2.0f, width / 2.0f);
+    Vector2 topLeft = GetScreenToWorld2D((Vector2){0, 0}, camera);
+    Vector2 bottomRight = GetScreenToWorld2D((Vector2){GetScreenWidth(), GetScreenHeight()}, camera);
+    Rectangle view = {topLeft.x, topLeft.y, bottomRight.x - topLeft.x, bottomRight.y - topLeft.y};
+    drawTree(&quadtree, center.x, center.y, width / 2.0f, width / 2.0f, view);
 }
 
 void drawQuadTreeOld(QuadTree quadtree, Vector2 center, float width, Camera2D camera) {
 
 #define DRAW_QUAD(tree, quad)                                                                                          \
-    (drawQuadTree(*AS_QUADTREE(tree.quad), centerOfQuadrant(quad, center, width / 2.0f), width / 2.0f, camera))
+    (drawQuadTree(*treeAt(tree.quad), centerOfQuadrant(quad, center, width / 2.0f), width / 2.0f, camera))
 #define DRAW_INT(tree, quad)                                                                                           \
     (drawCenteredSquare(centerOfQuadrant(quad, center, width / 2.0f), 0.9f * width / 2.0f,                             \
-                        AS_INT(tree.quad) == 0 ? BLACK : BLUE))
+                        AS_INT(leafAt(tree.quad)) == 0 ? BLACK : BLUE))
 
-    if (isTreeNode(quadtree.NW)) {
+    if (quadtree.depth > 1) {
         DRAW_QUAD(quadtree, NW);
         DRAW_QUAD(quadtree, NE);
         DRAW_QUAD(quadtree, SW);
@@ -388,19 +484,19 @@ void drawQuadTreeOld(QuadTree quadtree, Vector2 center, float width, Camera2D ca
 
 #ifdef DEBUG_QUADINFO
         Vector2 textPos = centerOfQuadrant(NW, center, width / 2.0f);
-        DrawText(TextFormat("%p \n %lu", AS_QUADTREE(quadtree.NW), AS_QUADTREE(quadtree.NW)->hash), textPos.x,
+        DrawText(TextFormat("%p \n %lu", treeAt(quadtree.NW), treeAt(quadtree.NW)->hash), textPos.x,
                  textPos.y, 12, WHITE);
         textPos = centerOfQuadrant(NE, center, width / 2.0f);
-        DrawText(TextFormat("%p \n %lu", AS_QUADTREE(quadtree.NE), AS_QUADTREE(quadtree.NE)->hash), textPos.x,
+        DrawText(TextFormat("%p \n %lu", treeAt(quadtree.NE), treeAt(quadtree.NE)->hash), textPos.x,
                  textPos.y, 12, WHITE);
         textPos = centerOfQuadrant(SW, center, width / 2.0f);
-        DrawText(TextFormat("%p \n %lu", AS_QUADTREE(quadtree.SW), AS_QUADTREE(quadtree.SW)->hash), textPos.x,
+        DrawText(TextFormat("%p \n %lu", treeAt(quadtree.SW), treeAt(quadtree.SW)->hash), textPos.x,
                  textPos.y, 12, WHITE);
         textPos = centerOfQuadrant(SE, center, width / 2.0f);
-        DrawText(TextFormat("%p \n %lu", AS_QUADTREE(quadtree.SE), AS_QUADTREE(quadtree.SE)->hash), textPos.x,
+        DrawText(TextFormat("%p \n %lu", treeAt(quadtree.SE), treeAt(quadtree.SE)->hash), textPos.x,
                  textPos.y, 12, WHITE);
 #endif
-    } else if (isLeaf(quadtree.NW)) {
+    } else {
         DRAW_INT(quadtree, NW);
         DRAW_INT(quadtree, NE);
         DRAW_INT(quadtree, SW);
@@ -424,12 +520,9 @@ void drawQuadFromPosition(Vector2 point, QuadTree *quadtree, Vector2 center, flo
     }
 
     QuadTree *subQuad = quadtree;
-    while (isSubdivided(*subQuad)) {
+    while (subQuad->depth > 1) {
         Quadrant quadrant = pointToQuadrant(point, center);
-        if (!IS_QUADTREE(quadrantGet(quadrant, subQuad))) {
-            break;
-        }
-        subQuad = AS_QUADTREE(quadrantGet(quadrant, subQuad));
+        subQuad = treeAt(quadrantGet(quadrant, subQuad));
         center = centerOfQuadrant(quadrant, center, width / 2.0f);
         width /= 2;
     }
@@ -438,7 +531,8 @@ void drawQuadFromPosition(Vector2 point, QuadTree *quadtree, Vector2 center, flo
     drawCenteredSquare(center, 2.0f, BLUE);
 }
 
-int maxQuads(const QuadTree *quadtree) { return pow(2, quadtree->depth); }
+// Cells across `quadtree`. Roots grow without limit, so this can be well beyond an int.
+int64_t maxQuads(const QuadTree *quadtree) { return (int64_t)1 << quadtree->depth; }
 
 float miniumumQuadSize(float width, const QuadTree *quadtree) { return width / (maxQuads(quadtree)); }
 
@@ -491,139 +585,422 @@ static int sand(CellNeighbourhood n) {
     return AS_INT(n.c);
 }
 
-static QuadTree *evolveBaseCase(QuadTree *quadtree) {
-    QuadTree *nw = AS_QUADTREE(quadtree->NW);
-    QuadTree *ne = AS_QUADTREE(quadtree->NE);
-    QuadTree *sw = AS_QUADTREE(quadtree->SW);
-    QuadTree *se = AS_QUADTREE(quadtree->SE);
+// Width of the square of cells the base case of `evolve` steps, which is a tree of depth 3.
+#define BASE_WIDTH 8
 
-    QuadrantValue (*f)(CellNeighbourhood n) = fluidNeighbourhood;
+// Copies the cells of `quadtree` into `cells`, a grid `BASE_WIDTH` wide, with its top left cell at `row` and `col`.
+static void readCells(const QuadTree *quadtree, QuadrantValue cells[][BASE_WIDTH], int row, int col) {
+    if (quadtree->depth == 1) {
+        cells[row][col] = leafAt(quadtree->NW);
+        cells[row][col + 1] = leafAt(quadtree->NE);
+        cells[row + 1][col] = leafAt(quadtree->SW);
+        cells[row + 1][col + 1] = leafAt(quadtree->SE);
+        return;
+    }
 
-    CellNeighbourhood n = fromQuadrantValues(nw->NW, nw->NE, ne->NW, nw->SW, nw->SE, ne->SW, sw->NW, sw->NE, se->NW);
-    QuadrantValue center_nw = f(n);
+    int half = 1 << (quadtree->depth - 1);
+    readCells(treeAt(quadtree->NW), cells, row, col);
+    readCells(treeAt(quadtree->NE), cells, row, col + half);
+    readCells(treeAt(quadtree->SW), cells, row + half, col);
+    readCells(treeAt(quadtree->SE), cells, row + half, col + half);
+}
 
-    n = fromQuadrantValues(nw->NE, ne->NW, ne->NE, nw->SE, ne->SW, ne->SE, sw->NE, se->NW, se->NE);
-    QuadrantValue center_ne = f(n);
+// The neighbourhood of the cell at `row` and `col` of `cells`.
+static CellNeighbourhood neighbourhoodAt(QuadrantValue cells[][BASE_WIDTH], int row, int col) {
+    QuadrantValue *above = cells[row - 1];
+    QuadrantValue *centre = cells[row];
+    QuadrantValue *below = cells[row + 1];
+    return fromQuadrantValues(above[col - 1], above[col], above[col + 1], centre[col - 1], centre[col], centre[col + 1],
+                              below[col - 1], below[col], below[col + 1]);
+}
 
-    n = fromQuadrantValues(nw->SW, nw->SE, ne->SW, sw->NW, sw->NE, se->NW, sw->SW, sw->SE, se->SW);
-    QuadrantValue center_sw = f(n);
+// Steps a tree of depth 3 a whole generation of the fluid rule, returning its centre. The rule has two stages, each
+// reaching one cell, so the 8x8 cells give a 6x6 first stage and a 4x4 result. The first stage holds occupation numbers
+// that only the second stage reads, so it is kept here rather than interned.
+static QuadTreeRef evolveBaseCase(QuadTree *quadtree) {
+    QuadrantValue (*f)(CellNeighbourhood n) = fluidNeighbourhood;
 
-    n = fromQuadrantValues(nw->SE, ne->SW, ne->SE, sw->NE, se->NW, se->NE, sw->SE, se->SW, se->SE);
-    QuadrantValue center_se = f(n);
+    QuadrantValue cells[BASE_WIDTH][BASE_WIDTH];
+    readCells(quadtree, cells, 0, 0);
 
-    QuadTree *result = node(0, center_nw, center_ne, center_sw, center_se);
+    // Each stage leaves the outermost ring of cells in place, as nothing is known about their neighbours
+    QuadrantValue collided[BASE_WIDTH][BASE_WIDTH];
+    for (int row = 1; row < BASE_WIDTH - 1; row++) {
+        for (int col = 1; col < BASE_WIDTH - 1; col++) {
+            collided[row][col] = f(neighbourhoodAt(cells, row, col));
+        }
+    }
 
+    QuadTreeRef centre[4][4];
+    for (int row = 0; row < 4; row++) {
+        for (int col = 0; col < 4; col++) {
+            centre[row][col] = internLeaf(f(neighbourhoodAt(collided, row + 2, col + 2)));
+        }
+    }
+
+    QuadTreeRef quarters[2][2];
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            int row = 2 * i;
+            int col = 2 * j;
+            quarters[i][j] = node(1, centre[row][col], centre[row][col + 1], centre[row + 1][col],
+                                  centre[row + 1][col + 1]);
+        }
+    }
+
+    QuadTreeRef result = node(2, quarters[0][0], quarters[0][1], quarters[1][0], quarters[1][1]);
     quadtree->result = result;
 
     return result;
 }
 
-// Returns a quadtree with a depth 1 lower than the given tree
-static QuadTree *evolve(QuadTree *quadtree) {
-    if (quadtree->result != NULL) {
+// Returns the tree half the width of `quadtree` at its centre.
+static QuadTreeRef centreOf(const QuadTree *quadtree) {
+    QuadTree *nw = treeAt(quadtree->NW);
+    QuadTree *ne = treeAt(quadtree->NE);
+    QuadTree *sw = treeAt(quadtree->SW);
+    QuadTree *se = treeAt(quadtree->SE);
+    return node(quadtree->depth - 1, nw->SE, ne->SW, sw->NE, se->NW);
+}
+
+// Fills `parts` with the nine overlapping trees of half the width of `quadtree`, spaced a quarter of its width apart.
+static void splitNinths(const QuadTree *quadtree, QuadTreeRef parts[3][3]) {
+    int depth = quadtree->depth - 1;
+    QuadTree *nw = treeAt(quadtree->NW);
+    QuadTree *ne = treeAt(quadtree->NE);
+    QuadTree *sw = treeAt(quadtree->SW);
+    QuadTree *se = treeAt(quadtree->SE);
+
+    parts[0][0] = quadtree->NW;
+    parts[0][1] = node(depth, nw->NE, ne->NW, nw->SE, ne->SW);
+    parts[0][2] = quadtree->NE;
+    parts[1][0] = node(depth, nw->SW, nw->SE, sw->NW, sw->NE);
+    parts[1][1] = node(depth, nw->SE, ne->SW, sw->NE, se->NW);
+    parts[1][2] = node(depth, ne->SW, ne->SE, se->NW, se->NE);
+    parts[2][0] = quadtree->SW;
+    parts[2][1] = node(depth, sw->NE, se->NW, sw->SE, se->SW);
+    parts[2][2] = quadtree->SE;
+}
+
+// Returns the centre of the given tree a generation later, with a depth 1 lower than the given tree
+static QuadTreeRef evolve(QuadTreeRef ref) {
+    QuadTree *quadtree = treeAt(ref);
+    stats.evolveCalls++;
+    if (quadtree->result != QUADTREE_NONE) {
+        stats.evolveHits++;
         return quadtree->result;
     }
 
-    if (quadtree->depth == 2) {
+    if (quadtree->depth == 3) {
         return evolveBaseCase(quadtree);
     }
 
-    QuadTree *nw = AS_QUADTREE(quadtree->NW);
-    QuadTree *ne = AS_QUADTREE(quadtree->NE);
-    QuadTree *sw = AS_QUADTREE(quadtree->SW);
-    QuadTree *se = AS_QUADTREE(quadtree->SE);
-
-    QuadTree *nw_center = evolve(AS_QUADTREE(quadtree->NW));
-    QuadTree *ne_center = evolve(AS_QUADTREE(quadtree->NE));
-    QuadTree *sw_center = evolve(AS_QUADTREE(quadtree->SW));
-    QuadTree *se_center = evolve(AS_QUADTREE(quadtree->SE));
-
-    QuadTree *n = evolve(&(QuadTree){
-        .depth = quadtree->depth - 1,
-        .NW = nw->NE,
-        .NE = ne->NW,
-        .SW = nw->SE,
-        .SE = ne->SW,
-    });
-
-    QuadTree *e = evolve(&(QuadTree){
-        .depth = quadtree->depth - 1,
-        .NW = ne->SW,
-        .NE = ne->SE,
-        .SW = se->NW,
-        .SE = se->NE,
-    });
-
-    QuadTree *s = evolve(&(QuadTree){
-        .depth = quadtree->depth - 1,
-        .NW = sw->NE,
-        .NE = se->NW,
-        .SW = sw->SE,
-        .SE = se->SW,
-    });
-
-    QuadTree *w = evolve(&(QuadTree){
-        .depth = quadtree->depth - 1,
-        .NW = nw->SW,
-        .NE = nw->SE,
-        .SW = sw->NW,
-        .SE = sw->NE,
-    });
-
-    QuadTree *c = evolve(&(QuadTree){
-        .depth = quadtree->depth - 1,
-        .NW = nw->SE,
-        .NE = ne->SW,
-        .SW = sw->NE,
-        .SE = se->NW,
-    });
-
-    QuadTree *result_nw = node(quadtree->depth - 2, nw_center->SE, n->SW, w->NE, c->NW);
-    QuadTree *result_ne = node(quadtree->depth - 2, n->SE, ne_center->SW, c->NE, e->NW);
-    QuadTree *result_sw = node(quadtree->depth - 2, w->SE, c->SW, sw_center->NE, s->NW);
-    QuadTree *result_se = node(quadtree->depth - 2, c->SE, e->SW, s->NE, se_center->NW);
-
-    QuadTree result = treeNode(quadtree->depth - 1, result_nw, result_ne, result_sw, result_se);
-
-    QuadTree *interned = copyQuadTree(&result);
-    quadtree->result = interned;
-
-    return interned;
+    // Step the nine overlapping parts, which are interned so their results are memoized for the next tree that
+    // shares them
+    QuadTreeRef parts[3][3];
+    splitNinths(quadtree, parts);
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            parts[i][j] = evolve(parts[i][j]);
+        }
+    }
+
+    // Each quarter of the result is pieced together from the four stepped parts that overlap it
+    QuadTreeRef quarters[2][2];
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            quarters[i][j] = node(quadtree->depth - 2, treeAt(parts[i][j])->SE, treeAt(parts[i][j + 1])->SW,
+                                  treeAt(parts[i + 1][j])->NE, treeAt(parts[i + 1][j + 1])->NW);
+        }
+    }
+
+    QuadTreeRef result = node(quadtree->depth - 1, quarters[0][0], quarters[0][1], quarters[1][0], quarters[1][1]);
+    quadtree->result = result;
+
+    return result;
 }
 
-QuadTree *evolveQuadtree(const QuadTree *quadtree) {
-    // TODO: Improve this by not recreating the empty each time - Possible store the quadtree in a 1 up date structure
-    // and work with that!
+// Returns `quadtree` in the centre of a tree twice as wide, surrounded by empty space.
+static QuadTreeRef padQuadTree(QuadTreeRef ref) {
+    QuadTree *quadtree = treeAt(ref);
+    int depth = quadtree->depth;
+    QuadTreeRef empty = emptyTree(depth - 1);
+
+    QuadTreeRef nw = node(depth, empty, empty, empty, quadtree->NW);
+    QuadTreeRef ne = node(depth, empty, empty, quadtree->NE, empty);
+    QuadTreeRef sw = node(depth, empty, quadtree->SW, empty, empty);
+    QuadTreeRef se = node(depth, quadtree->SE, empty, empty, empty);
+    return node(depth + 1, nw, ne, sw, se);
+}
+
+QuadTree *growQuadtree(const QuadTree *quadtree) { return treeAt(padQuadTree(quadtree->ref)); }
+
+static bool isEmptyQuadrant(int depth, QuadTreeRef ref);
+
+// Returns `true` if every cell of `quadtree` is empty. Empty trees are almost always the cached ones, so this rarely
+// has to look inside.
+static bool isEmptyTree(const QuadTree *quadtree) {
+    if (quadtree->ref == emptyTree(quadtree->depth)) {
+        return true;
+    }
+    int depth = quadtree->depth;
+    return isEmptyQuadrant(depth, quadtree->NW) && isEmptyQuadrant(depth, quadtree->NE) &&
+           isEmptyQuadrant(depth, quadtree->SW) && isEmptyQuadrant(depth, quadtree->SE);
+}
+
+// Returns `true` if the quadrant `ref` of a tree of depth `depth` is empty.
+static bool isEmptyQuadrant(int depth, QuadTreeRef ref) {
+    return depth == 1 ? isEmpty(leafAt(ref)) : isEmptyTree(treeAt(ref));
+}
+
+// Returns `true` if everything in `quadtree` is inside its centre, leaving a border a quarter of its width empty.
+static bool isBorderEmpty(const QuadTree *quadtree) {
+    QuadTree *nw = treeAt(quadtree->NW);
+    QuadTree *ne = treeAt(quadtree->NE);
+    QuadTree *sw = treeAt(quadtree->SW);
+    QuadTree *se = treeAt(quadtree->SE);
+    int depth = quadtree->depth - 1;
+    return isEmptyQuadrant(depth, nw->NW) && isEmptyQuadrant(depth, nw->NE) && isEmptyQuadrant(depth, nw->SW) &&
+           isEmptyQuadrant(depth, ne->NW) && isEmptyQuadrant(depth, ne->NE) && isEmptyQuadrant(depth, ne->SE) &&
+           isEmptyQuadrant(depth, sw->NW) && isEmptyQuadrant(depth, sw->SW) && isEmptyQuadrant(depth, sw->SE) &&
+           isEmptyQuadrant(depth, se->NE) && isEmptyQuadrant(depth, se->SW) && isEmptyQuadrant(depth, se->SE);
+}
+
+// Pads `quadtree` until it has an empty border, so nothing in it can step out of it for a quarter of its width.
+static QuadTreeRef expandQuadTree(QuadTreeRef root) {
+    while (treeAt(root)->depth < QUADTREE_MIN_DEPTH || !isBorderEmpty(treeAt(root))) {
+        root = padQuadTree(root);
+    }
+    return root;
+}
+
+// Crops `quadtree` to its centre while that would still have an empty border, so a root that has just been cropped
+// does not need expanding again on the next step.
+static QuadTreeRef cropQuadTree(QuadTreeRef root) {
+    QuadTree *quadtree = treeAt(root);
+    while (quadtree->depth > QUADTREE_MIN_DEPTH && isBorderEmpty(quadtree) &&
+           isBorderEmpty(treeAt(centreOf(quadtree)))) {
+        quadtree = treeAt(centreOf(quadtree));
+    }
+    return quadtree->ref;
+}
+
+// Returns the centre of `quadtree` after `1 << log2Steps` generations, with a depth 1 lower than the given tree.
+// Information moves at most two cells a generation, so the centre can be stepped up to an eighth of the tree's width
+// and `log2Steps` must be at most `quadtree->depth - 3`.
+//
+// At that limit the tree is split into nine overlapping parts which are each stepped half way, then joined into four
+// which step the rest of the way, so every level doubles the steps of the one below. Smaller steps only move the nine
+// parts, and the four just take their centres. Results are memoized on the interned trees for every step size they are
+// asked for, so leaps of different sizes do not undo each other's work.
+static QuadTreeRef leap(QuadTreeRef ref, int log2Steps) {
+    if (log2Steps == 0) {
+        return evolve(ref);
+    }
+    QuadTree *quadtree = treeAt(ref);
+    stats.leapCalls++;
+    for (SlabHandle handle = quadtree->leaps; handle != SLAB_NO_HANDLE; handle = memoAt(handle)->next) {
+        if (memoAt(handle)->log2Steps == log2Steps) {
+            stats.leapHits++;
+            return memoAt(handle)->result;
+        }
+    }
 
-    // Game of life
-    QuadTree *empty = newConstantQuadTree(quadtree->depth - 1, -1);
+    int depth = quadtree->depth;
+    bool doubling = log2Steps == depth - 3;
+    int partSteps = doubling ? log2Steps - 1 : log2Steps;
 
-    // Testing
-    // QuadTree *empty = newConstantQuadTree(quadtree->depth - 1, -1);
+    QuadTreeRef parts[3][3];
+    splitNinths(quadtree, parts);
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            parts[i][j] = leap(parts[i][j], partSteps);
+        }
+    }
 
-    QuadTree nw = treeNode(quadtree->depth, empty, empty, empty, AS_QUADTREE(quadtree->NW));
-    QuadTree ne = treeNode(quadtree->depth, empty, empty, AS_QUADTREE(quadtree->NE), empty);
-    QuadTree sw = treeNode(quadtree->depth, empty, AS_QUADTREE(quadtree->SW), empty, empty);
-    QuadTree se = treeNode(quadtree->depth, AS_QUADTREE(quadtree->SE), empty, empty, empty);
+    QuadTreeRef quarters[2][2];
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            QuadTreeRef joined = node(depth - 1, parts[i][j], parts[i][j + 1], parts[i + 1][j], parts[i + 1][j + 1]);
+            quarters[i][j] = doubling ? leap(joined, partSteps) : centreOf(treeAt(joined));
+        }
+    }
 
-    QuadTree wrapped = treeNode(quadtree->depth + 1, &nw, &ne, &sw, &se);
+    QuadTreeRef result = node(depth - 1, quarters[0][0], quarters[0][1], quarters[1][0], quarters[1][1]);
+    LeapMemo *memo = slabAllocate(&memos);
+    *memo = (LeapMemo){.result = result, .next = quadtree->leaps, .log2Steps = log2Steps};
+    quadtree->leaps = slabHandle(&memos, memo);
+    return result;
+}
 
-    // DONT DO THIS! You should never edit the contents of an interned object
-    // AS_QUADTREE(wrapper->NW)->SE = quadtree->NW;
-    // AS_QUADTREE(wrapper->NE)->SW = quadtree->NE;
-    // AS_QUADTREE(wrapper->SW)->NE = quadtree->SW;
-    // AS_QUADTREE(wrapper->SE)->NW = quadtree->SE;
+// Garbage collection
 
-    QuadTree *temp = evolve(&wrapped);
+// Bytes taken by the interned trees and the tables they are found in. Leaves are few and never freed, so they are left
+// out.
+static size_t quadTreeBytes() {
+    return nodes.used * nodes.objectSize + memos.used * memos.objectSize + sizeof(Entry) * quadtrees.capacity;
+}
 
-    // We do it twice because the fluid process is two stage.
-    empty = newConstantQuadTree(quadtree->depth - 1, -1);
+// Marks `quadtree` and every tree in it. Memoized results are not followed, so they are only kept while something else
+// reaches them.
+static void markQuadTree(QuadTree *quadtree) {
+    if (quadtree == NULL || quadtree->isMarked) {
+        return;
+    }
+    quadtree->isMarked = true;
+
+    // The quadrants of trees of depth 1 are leaves
+    if (quadtree->depth > 1) {
+        markQuadTree(treeAt(quadtree->NW));
+        markQuadTree(treeAt(quadtree->NE));
+        markQuadTree(treeAt(quadtree->SW));
+        markQuadTree(treeAt(quadtree->SE));
+    }
+}
 
-    nw = treeNode(quadtree->depth, empty, empty, empty, AS_QUADTREE(temp->NW));
-    ne = treeNode(quadtree->depth, empty, empty, AS_QUADTREE(temp->NE), empty);
-    sw = treeNode(quadtree->depth, empty, AS_QUADTREE(temp->SW), empty, empty);
-    se = treeNode(quadtree->depth, AS_QUADTREE(temp->SE), empty, empty, empty);
+static void markRoots(QuadTree *quadtree) {
+    for (int i = 0; i < rootCount; i++) {
+        markQuadTree(*roots[i]);
+    }
+    for (int depth = 1; depth < emptyTreesCount; depth++) {
+        markQuadTree(treeAt(emptyTrees[depth]));
+    }
+    markQuadTree(quadtree);
+}
 
-    wrapped = treeNode(quadtree->depth + 1, &nw, &ne, &sw, &se);
-    return evolve(&wrapped);
+// Forgets the leap results memoized on `quadtree`, only keeping those that were marked unless `all` is set.
+static void forgetLeaps(QuadTree *quadtree, bool all) {
+    SlabHandle *link = &quadtree->leaps;
+    while (*link != SLAB_NO_HANDLE) {
+        LeapMemo *memo = memoAt(*link);
+        if (!all && treeAt(memo->result)->isMarked) {
+            link = &memo->next;
+            continue;
+        }
+        *link = memo->next;
+        slabFree(&memos, memo);
+    }
+}
+
+// Frees every tree that was not marked. Memoized results pointing at them are forgotten first, while they can still be
+// looked at.
+static void sweepQuadTrees() {
+    for (int i = 0; i < quadtrees.capacity; i++) {
+        QuadTree *quadtree = quadtrees.entries[i].value;
+        if (quadtree == NULL || !quadtree->isMarked) {
+            continue;
+        }
+        if (quadtree->result != QUADTREE_NONE && !treeAt(quadtree->result)->isMarked) {
+            quadtree->result = QUADTREE_NONE;
+        }
+        forgetLeaps(quadtree, false);
+    }
+
+    for (int i = 0; i < quadtrees.capacity; i++) {
+        Entry *entry = &quadtrees.entries[i];
+        QuadTree *quadtree = entry->value;
+        if (quadtree == NULL) {
+            continue;
+        }
+        if (quadtree->isMarked) {
+            quadtree->isMarked = false;
+            continue;
+        }
+        forgetLeaps(quadtree, true);
+        tableDelete(&quadtrees, entry->hash, quadtree);
+        slabFree(&nodes, quadtree);
+        stats.treesFreed++;
+    }
+    tableCompact(&quadtrees);
+}
+
+// Frees the trees that cannot be reached from `quadtree`, a registered root or the cached empty trees.
+static void collect(QuadTree *quadtree) {
+#ifdef DEBUG_LOG_GC
+    LogMessage(LOG_DEBUG, "-- quadtree gc begin");
+    size_t before = quadTreeBytes();
+#endif
+
+    markRoots(quadtree);
+    sweepQuadTrees();
+    stats.collections++;
+
+    size_t after = quadTreeBytes();
+    nextCollect = after * QUADTREE_GC_GROW_FACTOR > QUADTREE_GC_THRESHOLD ? after * QUADTREE_GC_GROW_FACTOR
+                                                                          : QUADTREE_GC_THRESHOLD;
+
+#ifdef DEBUG_LOG_GC
+    LogMessage(LOG_DEBUG, "-- quadtree gc end");
+    LogMessage(LOG_DEBUG, "   collected %zu bytes (from %zu to %zu) next at %zu", before - after, before, after,
+               nextCollect);
+#endif
+}
+
+void collectQuadTrees() { collect(NULL); }
+
+// Collects once the trees have outgrown the threshold. Only called between steps, where `quadtree` and the registered
+// roots are the only trees still in use.
+static void collectIfNeeded(QuadTree *quadtree) {
+#ifdef DEBUG_STRESS_GC
+    collect(quadtree);
+#else
+    if (quadTreeBytes() > nextCollect) {
+        collect(quadtree);
+    }
+#endif
+}
+
+void freeQuadTrees() {
+    freeTable(&quadtrees);
+    freeSlab(&nodes);
+    freeSlab(&memos);
+
+    freeLeafTable(&leaves);
+
+    FREE_ARRAY(QuadTreeRef, emptyTrees, emptyTreesCapacity);
+    emptyTrees = NULL;
+    emptyTreesCount = 0;
+    emptyTreesCapacity = 0;
+
+    FREE_ARRAY(QuadTree **, roots, rootCapacity);
+    roots = NULL;
+    rootCount = 0;
+    rootCapacity = 0;
+
+    nextCollect = QUADTREE_GC_THRESHOLD;
+}
+
+// Steps `quadtree` `1 << log2Steps` generations. Once everything is inside the centre of the root, one more level of
+// padding that is also deep enough to leap that far leaves room for it to move all the way without leaving the result.
+static QuadTreeRef leapQuadtree(QuadTreeRef quadtree, int log2Steps) {
+    QuadTreeRef root = expandQuadTree(quadtree);
+    int depth = treeAt(root)->depth > log2Steps + 3 ? treeAt(root)->depth : log2Steps + 3;
+
+    QuadTreeRef padded = padQuadTree(root);
+    while (treeAt(padded)->depth <= depth) {
+        padded = padQuadTree(padded);
+    }
+    return cropQuadTree(leap(padded, log2Steps));
+}
+
+// Steps `quadtree` a generation. The root grows when anything comes near its edge and shrinks when its border is
+// empty, so the universe is unbounded. Trees not reachable from `quadtree` or a registered root may be freed.
+QuadTree *evolveQuadtree(const QuadTree *quadtree) {
+    collectIfNeeded((QuadTree *)quadtree);
+    QuadTreeRef root = expandQuadTree(quadtree->ref);
+    return treeAt(cropQuadTree(evolve(padQuadTree(root))));
+}
+
+// Advances `quadtree` by `generations`, in a leap for each set bit of the count. Each leap takes time in the number of
+// distinct trees it meets rather than the number of steps, so long runs of a pattern that repeats are cheap. Trees not
+// reachable from `quadtree` or a registered root may be freed between leaps.
+QuadTree *advanceQuadtree(const QuadTree *quadtree, unsigned long generations) {
+    QuadTreeRef result = quadtree->ref;
+    for (int bit = 0; bit < (int)(sizeof(generations) * 8); bit++) {
+        if (generations & (1ul << bit)) {
+            collectIfNeeded(treeAt(result));
+            result = leapQuadtree(result, bit);
+        }
+    }
+    return treeAt(result);
 }
@@ -6,6 +6,16 @@
 #include "raylib.h"
 
 #define QUADTREE_MAX_DEPTH 6
+// Roots are never cropped below this depth, so an empty universe keeps some room to paint in.
+#define QUADTREE_MIN_DEPTH 5
+
+// Bytes of interned trees there can be before stepping first collects the ones that are no longer reachable. Can be set
+// when building.
+#ifndef QUADTREE_GC_THRESHOLD
+#define QUADTREE_GC_THRESHOLD (64 * 1024 * 1024)
+#endif
+// After a collection, the next one waits until the trees left have grown by this factor.
+#define QUADTREE_GC_GROW_FACTOR 2
 
 typedef struct QuadTree QuadTree;
 
@@ -77,35 +87,71 @@ typedef struct CellNeighbourhood {
     QuadrantValue se;
 } CellNeighbourhood;
 
-typedef struct QuadTree {
-    int depth;
-
-    struct QuadrantValue NW;
-    struct QuadrantValue NE;
-    struct QuadrantValue SW;
-    struct QuadrantValue SE;
+// Names an interned tree by its 32 bit handle in the node slab. The quadrants of a tree of depth 1 name leaf values
+// instead, by their index in the leaf table.
+typedef uint32_t QuadTreeRef;
 
-    uint32_t hash;
+#define QUADTREE_NONE 0
 
-    QuadTree *result;
+typedef struct QuadTree {
+    QuadTreeRef NW;
+    QuadTreeRef NE;
+    QuadTreeRef SW;
+    QuadTreeRef SE;
+
+    uint64_t hash;
+
+    QuadTreeRef result;
+    uint32_t leaps;  // The leap results memoized for the tree, one for each step size asked for, see quadtree.c.
+    QuadTreeRef ref; // The tree's own handle, which fits in what would otherwise be padding.
+    uint8_t depth;
+    bool isMarked; // Reached from a root in the collection under way.
 } QuadTree;
 
 #define GET_QUADRANT(quadtree, value) ((quadtree).value)
 
+// Counts of how often evolving and leaping trees were answered from a memoized result, and of the work looking trees
+// up in the intern table took.
+typedef struct QuadTreeStats {
+    unsigned long evolveCalls;
+    unsigned long evolveHits;
+    unsigned long leapCalls;
+    unsigned long leapHits;
+
+    unsigned long internLookups;
+    unsigned long internProbes;     // Slots passed over, in all lookups.
+    unsigned long internCollisions; // Other trees with the same hash met by lookups.
+    unsigned long longestProbe;
+
+    unsigned long collections;
+    unsigned long treesFreed;
+
+    int leaves; // Distinct leaf values interned.
+} QuadTreeStats;
+
 void printTreeTable();
 void initQuadTable();
+QuadTreeStats quadTreeStats();
+void resetQuadTreeStats();
+void freeQuadTrees();
+
+void addQuadTreeRoot(QuadTree **root);
+void removeQuadTreeRoot(QuadTree **root);
+void collectQuadTrees();
 
 bool quadtreesEqual(const QuadTree *left, const QuadTree *right);
-bool isSubdivided(QuadTree quadtree);
+bool quadrantValuesEqual(QuadrantValue left, QuadrantValue right);
 
 QuadTree *newEmptyQuadTree(int depth);
+QuadTree *growQuadtree(const QuadTree *quadtree);
 QuadTree *setPointInQuadTree(Vector2 point, Vector2 center, float width, const QuadTree *quadtree, QuadrantValue value);
 
 void drawQuadTree(QuadTree quadtree, Vector2 center, float width, Camera2D camera);
 void drawQuadFromPosition(Vector2 point, QuadTree *quadtree, Vector2 center, float width);
 
-int maxQuads(const QuadTree *quadtree);
+int64_t maxQuads(const QuadTree *quadtree);
 float miniumumQuadSize(float width, const QuadTree *quadtree);
 
 QuadTree *evolveQuadtree(const QuadTree *quadtree);
+QuadTree *advanceQuadtree(const QuadTree *quadtree, unsigned long generations);
 #endif // ptest_quadtree_h
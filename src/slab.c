@@ -0,0 +1,102 @@
+#include "slab.h"
+#include "debug.h"
+#include "memory.h"
+
+#include <raylib.h>
+#include <stdint.h>
+
+void initSlab(Slab *slab, size_t objectSize) {
+    // Freed objects hold the link to the next one
+    slab->objectSize = SLAB_ALIGN_UP(objectSize < sizeof(void *) ? sizeof(void *) : objectSize);
+    slab->pages = NULL;
+    slab->pageCount = 0;
+    slab->pageCapacity = 0;
+    slab->cut = 0;
+    slab->freeList = NULL;
+    slab->used = 0;
+}
+
+void freeSlab(Slab *slab) {
+    for (int i = 0; i < slab->pageCount; i++) {
+        freeAligned(slab->pages[i]);
+    }
+    FREE_ARRAY(SlabPage *, slab->pages, slab->pageCapacity);
+    initSlab(slab, slab->objectSize);
+}
+
+static SlabPage *pageOf(const void *object) {
+    return (SlabPage *)((uintptr_t)object & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+}
+
+static char *pageObject(SlabPage *page, int index, size_t objectSize) {
+    return (char *)page + SLAB_HEADER_SIZE + (size_t)index * objectSize;
+}
+
+static SlabPage *addPage(Slab *slab) {
+    if (slab->pageCount + 1 > slab->pageCapacity) {
+        int oldCapacity = slab->pageCapacity;
+        slab->pageCapacity = GROW_CAPACITY(oldCapacity);
+        slab->pages = GROW_ARRAY(SlabPage *, slab->pages, oldCapacity, slab->pageCapacity);
+    }
+
+    SlabPage *page = allocateAligned(SLAB_PAGE_SIZE, SLAB_PAGE_SIZE);
+    page->used = 0;
+    page->capacity = (int)((SLAB_PAGE_SIZE - SLAB_HEADER_SIZE) / slab->objectSize);
+    page->index = slab->pageCount;
+    slab->pages[slab->pageCount++] = page;
+    slab->cut = 0;
+    return page;
+}
+
+void *slabAllocate(Slab *slab) {
+    void *object;
+    if (slab->freeList != NULL) {
+        object = slab->freeList;
+        slab->freeList = *(void **)object;
+    } else {
+        SlabPage *page = slab->pageCount > 0 ? slab->pages[slab->pageCount - 1] : NULL;
+        if (page == NULL || slab->cut == page->capacity) {
+            page = addPage(slab);
+        }
+        object = pageObject(page, slab->cut++, slab->objectSize);
+    }
+
+    pageOf(object)->used++;
+    slab->used++;
+    return object;
+}
+
+void slabFree(Slab *slab, void *object) {
+    pageOf(object)->used--;
+    slab->used--;
+    *(void **)object = slab->freeList;
+    slab->freeList = object;
+}
+
+SlabHandle slabHandle(const Slab *slab, const void *object) {
+    SlabPage *page = pageOf(object);
+    uint32_t slot = (uint32_t)(((const char *)object - (const char *)page - SLAB_HEADER_SIZE) / slab->objectSize);
+    return ((uint32_t)page->index << SLAB_SLOT_BITS | slot) + 1;
+}
+
+SlabStats slabStats(const Slab *slab) {
+    SlabStats stats = {.pages = slab->pageCount, .used = slab->used};
+    for (int i = 0; i < slab->pageCount; i++) {
+        SlabPage *page = slab->pages[i];
+        // Only the part of the last page that has been cut can be in use
+        int available = i == slab->pageCount - 1 ? slab->cut : page->capacity;
+        stats.capacity += page->capacity;
+        stats.freeListed += available - page->used;
+        stats.emptyPages += page->used == 0;
+        stats.fullPages += page->used == page->capacity;
+    }
+    return stats;
+}
+
+void logSlabStats(const Slab *slab, const char *name) {
+    SlabStats stats = slabStats(slab);
+    double fill = stats.capacity > 0 ? 100.0 * stats.used / stats.capacity : 0.0;
+    LogMessage(LOG_INFO, "Slab %s: %d pages of %d bytes, %zu / %zu objects in use (%.1f%%), %zu on the free list",
+               name, stats.pages, SLAB_PAGE_SIZE, stats.used, stats.capacity, fill, stats.freeListed);
+    LogMessage(LOG_INFO, "Slab %s: %d pages full, %d pages empty", name, stats.fullPages, stats.emptyPages);
+}
@@ -0,0 +1,77 @@
+#ifndef ptest_slab_h
+#define ptest_slab_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bytes in a slab page. Pages are aligned to their size, so the page an object is in is found by masking its address.
+// Pages are large enough that they are mapped on their own rather than carved out of the heap, where aligning them to
+// their size would waste most of a page in front of each.
+#define SLAB_PAGE_SIZE (1024 * 1024)
+
+// Start of each page, in front of its objects.
+typedef struct SlabPage {
+    int used;     // Objects of the page in use.
+    int capacity; // Objects the page has room for.
+    int index;    // Place of the page in the slab's pages.
+} SlabPage;
+
+// Objects are aligned to this, which is enough for pointers and 64 bit integers.
+#define SLAB_ALIGNMENT 8
+
+#define SLAB_ALIGN_UP(size) (((size) + SLAB_ALIGNMENT - 1) / SLAB_ALIGNMENT * SLAB_ALIGNMENT)
+
+// Offset of the first object of a page, after its header.
+#define SLAB_HEADER_SIZE SLAB_ALIGN_UP(sizeof(SlabPage))
+
+// Objects can be named by a 32 bit handle as well as by their address. The handle holds the index of the object's page
+// above the low `SLAB_SLOT_BITS` bits and its slot in the page below, plus one so that no object has the handle
+// `SLAB_NO_HANDLE`. A page has room for at most `SLAB_PAGE_SIZE / sizeof(void *)` objects, which fits in the slot bits.
+typedef uint32_t SlabHandle;
+
+#define SLAB_SLOT_BITS 17
+#define SLAB_SLOT_MASK ((1u << SLAB_SLOT_BITS) - 1)
+#define SLAB_NO_HANDLE 0
+
+// An allocator for many objects of one size. Objects are cut from large pages one after another, so objects made
+// together sit together in memory, and freed objects are kept on a free list to be handed out again before the pages
+// are cut any further.
+typedef struct Slab {
+    size_t objectSize;
+    SlabPage **pages;
+    int pageCount;
+    int pageCapacity;
+    int cut;        // Objects cut from the last page so far.
+    void *freeList; // Freed objects, each holding a pointer to the next.
+    size_t used;    // Objects in use, over all pages.
+} Slab;
+
+typedef struct SlabStats {
+    int pages;
+    size_t used;
+    size_t capacity;
+    size_t freeListed;
+    int emptyPages; // Pages with no objects in use, whose objects are all on the free list.
+    int fullPages;
+} SlabStats;
+
+void initSlab(Slab *slab, size_t objectSize);
+void freeSlab(Slab *slab);
+
+void *slabAllocate(Slab *slab);
+void slabFree(Slab *slab, void *object);
+SlabHandle slabHandle(const Slab *slab, const void *object);
+
+// Returns the object named by `handle`. Kept in the header, as following handles is most of what walking a structure
+// built out of them does.
+static inline void *slabObject(const Slab *slab, SlabHandle handle) {
+    uint32_t index = handle - 1;
+    char *page = (char *)slab->pages[index >> SLAB_SLOT_BITS];
+    return page + SLAB_HEADER_SIZE + (size_t)(index & SLAB_SLOT_MASK) * slab->objectSize;
+}
+
+SlabStats slabStats(const Slab *slab);
+void logSlabStats(const Slab *slab, const char *name);
+
+#endif // ptest_slab_h
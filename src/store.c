@@ -0,0 +1,152 @@
+#include "store.h"
+#include "debug.h"
+#include "memory.h"
+
+#include <raylib.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+// Stores need mmap, so on windows opening one fails and callers keep everything in memory.
+bool openStore(Store *store, const char *path, size_t slotSize) {
+    (void)slotSize;
+    store->fd = -1;
+    LogMessage(LOG_WARNING, "Cannot open store %s, mapped stores are not supported on this platform", path);
+    return false;
+}
+
+void closeStore(Store *store) { (void)store; }
+
+int reserveSlot(Store *store) {
+    (void)store;
+    return -1;
+}
+
+void releaseSlot(Store *store, int slot) {
+    (void)store;
+    (void)slot;
+}
+
+void *mapSlot(Store *store, int slot) {
+    (void)store;
+    (void)slot;
+    return NULL;
+}
+
+void unmapSlot(Store *store, void *map) {
+    (void)store;
+    (void)map;
+}
+
+void prefetchSlot(Store *store, int slot) {
+    (void)store;
+    (void)slot;
+}
+
+bool readSlot(const Store *store, int slot, size_t offset, void *buffer, size_t size) {
+    (void)store;
+    (void)slot;
+    (void)offset;
+    (void)buffer;
+    (void)size;
+    return false;
+}
+
+#else
+
+// Opens a store of `slotSize` byte slots backed by a new file at `path`. Returns `false` if the file cannot be made.
+bool openStore(Store *store, const char *path, size_t slotSize) {
+    store->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (store->fd < 0) {
+        LogMessage(LOG_WARNING, "Cannot open store %s", path);
+        return false;
+    }
+    unlink(path);
+
+    // Slots are mapped on their own, so they have to start on a page
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    store->slotSize = (slotSize + page - 1) / page * page;
+    store->slots = 0;
+    store->used = 0;
+    store->released = NULL;
+    store->releasedCount = 0;
+    store->releasedCapacity = 0;
+    return true;
+}
+
+void closeStore(Store *store) {
+    if (store->fd < 0) {
+        return;
+    }
+
+    close(store->fd);
+    FREE_ARRAY(int, store->released, store->releasedCapacity);
+    store->fd = -1;
+}
+
+// Returns a slot which is not in use. The file is grown when every slot is taken.
+int reserveSlot(Store *store) {
+    if (store->releasedCount > 0) {
+        return store->released[--store->releasedCount];
+    }
+
+    if (store->used == store->slots) {
+        int slots = GROW_CAPACITY(store->slots);
+        if (ftruncate(store->fd, (off_t)store->slotSize * slots) != 0) {
+            // Disk has ran out!
+            LogMessage(LOG_ERROR, "Cannot grow store to %d slots", slots);
+            exit(1);
+        }
+        store->slots = slots;
+    }
+
+    return store->used++;
+}
+
+void releaseSlot(Store *store, int slot) {
+    if (store->releasedCount == store->releasedCapacity) {
+        int capacity = GROW_CAPACITY(store->releasedCapacity);
+        store->released = GROW_ARRAY(int, store->released, store->releasedCapacity, capacity);
+        store->releasedCapacity = capacity;
+    }
+
+    store->released[store->releasedCount++] = slot;
+}
+
+// Maps `slot` into memory. Writes to the mapping end up in the file, so nothing is lost when it is unmapped.
+void *mapSlot(Store *store, int slot) {
+    off_t offset = (off_t)store->slotSize * slot;
+    void *map = mmap(NULL, store->slotSize, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, offset);
+    if (map == MAP_FAILED) {
+        // Address space has ran out!
+        LogMessage(LOG_ERROR, "Cannot map slot %d of store", slot);
+        exit(1);
+    }
+
+    return map;
+}
+
+void unmapSlot(Store *store, void *map) { munmap(map, store->slotSize); }
+
+// Asks for `slot` to be read ahead, so mapping it later does not wait on the disk.
+void prefetchSlot(Store *store, int slot) {
+#ifdef POSIX_FADV_WILLNEED
+    posix_fadvise(store->fd, (off_t)store->slotSize * slot, (off_t)store->slotSize, POSIX_FADV_WILLNEED);
+#else
+    (void)store;
+    (void)slot;
+#endif
+}
+
+// Reads `size` bytes at `offset` into `slot` without mapping it.
+bool readSlot(const Store *store, int slot, size_t offset, void *buffer, size_t size) {
+    return pread(store->fd, buffer, size, (off_t)store->slotSize * slot + (off_t)offset) == (ssize_t)size;
+}
+
+#endif
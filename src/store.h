@@ -0,0 +1,30 @@
+#ifndef ptest_store_h
+#define ptest_store_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A scratch file split into fixed size slots, which are mapped into memory while in use and left to the page cache
+// otherwise. The file is unlinked as soon as it is opened, so it goes away with the process.
+typedef struct Store {
+    int fd;
+    size_t slotSize; // Bytes in a slot, a multiple of the page size.
+    int slots;       // Slots the file has room for.
+    int used;        // Slots handed out, including released ones.
+    int *released;   // Slots given back, which are handed out again before new ones.
+    int releasedCount;
+    int releasedCapacity;
+} Store;
+
+bool openStore(Store *store, const char *path, size_t slotSize);
+void closeStore(Store *store);
+
+int reserveSlot(Store *store);
+void releaseSlot(Store *store, int slot);
+
+void *mapSlot(Store *store, int slot);
+void unmapSlot(Store *store, void *map);
+void prefetchSlot(Store *store, int slot);
+bool readSlot(const Store *store, int slot, size_t offset, void *buffer, size_t size);
+
+#endif // ptest_store_h
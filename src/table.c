@@ -9,6 +9,14 @@ void initTable(Table *table) {
     table->count = 0;
     table->capacity = 0;
     table->entries = NULL;
+    tableResetStats(table);
+}
+
+void tableResetStats(Table *table) {
+    table->lookups = 0;
+    table->probes = 0;
+    table->collisions = 0;
+    table->longestProbe = 0;
 }
 
 void freeTable(Table *table) {
@@ -16,53 +24,51 @@ void freeTable(Table *table) {
     initTable(table);
 }
 
-static Entry *findEntry(Entry *entries, int capacity, uint32_t key) {
-    uint32_t index = key % capacity;
+static bool isTombstone(const Entry *entry) { return entry->value == NULL && entry->hash == TABLE_TOMBSTONE; }
+
+// Returns the slot holding `value`, or the slot it should be inserted in. That is the first tombstone passed on the
+// way, so deleted slots are reused, or otherwise the empty slot the probe ended on.
+static Entry *findEntry(Entry *entries, int capacity, uint64_t hash, const QuadTree *value) {
+    uint64_t mask = (uint64_t)capacity - 1;
+    uint64_t index = hash & mask;
+    Entry *tombstone = NULL;
 
     for (;;) {
         Entry *entry = &entries[index];
-        if (entry->key == -1) {
-            // Empty entry
-            return entry;
-        } else if (entry->key == key) {
+        if (entry->value == NULL) {
+            if (!isTombstone(entry)) {
+                // Empty entry
+                return tombstone != NULL ? tombstone : entry;
+            }
+            if (tombstone == NULL) {
+                tombstone = entry;
+            }
+        } else if (entry->value == value) {
             return entry;
         }
 
-        index = (index + 1) % capacity;
+        index = (index + 1) & mask;
     }
 }
 
-// Returns `true` if a the key is found in the table, and stores its value in `out`
-bool tableGet(Table *table, uint32_t key, QuadTree *out) {
-    if (table->count == 0) {
-        return false;
-    }
-
-    Entry *entry = findEntry(table->entries, table->capacity, key);
-    // If the entries bucket is empty the key will be 0
-    if (entry->key == -1) {
-        return false;
-    }
-
-    *out = *entry->value;
-    return true;
-}
-
 static void adjustCapacity(Table *table, int capacity) {
     Entry *entries = ALLOCATE(Entry, capacity);
     for (int i = 0; i < capacity; i++) {
-        entries[i].key = -1;
+        entries[i].hash = 0;
         entries[i].value = NULL;
     }
 
+    // Tombstones are dropped, so the count is rebuilt from the trees that are left
+    table->count = 0;
     for (int i = 0; i < table->capacity; i++) {
         Entry *entry = &table->entries[i];
-        if (entry->key == -1)
+        if (entry->value == NULL)
             continue;
 
-        Entry *dest = findEntry(entries, capacity, entry->key);
-        dest->key = entry->key;
+        Entry *dest = findEntry(entries, capacity, entry->hash, entry->value);
+        dest->hash = entry->hash;
         dest->value = entry->value;
+        table->count++;
     }
 
     FREE_ARRAY(Entry, table->entries, table->capacity);
@@ -70,48 +76,168 @@ static void adjustCapacity(Table *table, int capacity) {
     table->capacity = capacity;
 }
 
-bool tableSet(Table *table, uint32_t key, QuadTree *value) {
+// Adds `value` to the table under `hash`. Returns `true` if it was not already in the table.
+bool tableSet(Table *table, uint64_t hash, QuadTree *value) {
     if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
         int capacity = GROW_CAPACITY(table->capacity);
         adjustCapacity(table, capacity);
     }
 
-    Entry *entry = findEntry(table->entries, table->capacity, key);
-    bool isNewKey = entry->key == -1;
-    if (isNewKey) {
+    Entry *entry = findEntry(table->entries, table->capacity, hash, value);
+    bool isNewKey = entry->value == NULL;
+    // Reusing a tombstone does not change the count, as tombstones are counted already
+    if (isNewKey && !isTombstone(entry)) {
         table->count++;
     }
 
-    entry->key = key;
+    entry->hash = hash;
     entry->value = value;
     return isNewKey;
 }
 
+// Removes `value` from the table, leaving a tombstone in its slot. Returns `true` if it was in the table.
+bool tableDelete(Table *table, uint64_t hash, const QuadTree *value) {
+    if (table->count == 0) {
+        return false;
+    }
+
+    Entry *entry = findEntry(table->entries, table->capacity, hash, value);
+    if (entry->value == NULL) {
+        return false;
+    }
+
+    entry->hash = TABLE_TOMBSTONE;
+    entry->value = NULL;
+    return true;
+}
+
+// Rebuilds the table without its tombstones, at the smallest capacity that leaves its trees room to double. Used after
+// many trees are deleted at once.
+void tableCompact(Table *table) {
+    int live = 0;
+    for (int i = 0; i < table->capacity; i++) {
+        live += table->entries[i].value != NULL;
+    }
+
+    int capacity = GROW_CAPACITY(0);
+    while (live * 2 > capacity * TABLE_MAX_LOAD) {
+        capacity = GROW_CAPACITY(capacity);
+    }
+    if (table->capacity > 0) {
+        adjustCapacity(table, capacity);
+    }
+}
+
 void tableAddAll(Table *from, Table *to) {
     for (int i = 0; i < from->capacity; i++) {
         Entry *entry = &from->entries[i];
-        if (entry->key != -1) {
-            tableSet(to, entry->key, entry->value);
+        if (entry->value != NULL) {
+            tableSet(to, entry->hash, entry->value);
         }
     }
 }
 
-QuadTree *tableFindQuadTree(Table *table, const QuadTree *quadtree, uint32_t hash) {
+// Returns the interned tree with the same depth and quadrants as `quadtree`, or NULL if there is none. The full hash is
+// compared before the quadrants, so trees in the same probe chain with other hashes cost a single comparison.
+QuadTree *tableFindQuadTree(Table *table, const QuadTree *quadtree, uint64_t hash) {
     if (table->count == 0) {
         return NULL;
     }
 
-    uint32_t index = hash % table->capacity;
-    for (;;) {
+    table->lookups++;
+    uint64_t mask = (uint64_t)table->capacity - 1;
+    uint64_t index = hash & mask;
+    QuadTree *found = NULL;
+    unsigned long probes = 0;
+    for (;; probes++) {
         Entry *entry = &table->entries[index];
-        if (entry->key == -1) {
-            return NULL;
-        } else if (entry->key == hash && quadtreesEqual(entry->value, quadtree)) {
-            return entry->value;
+        if (entry->value == NULL) {
+            if (!isTombstone(entry)) {
+                break;
+            }
+        } else if (entry->hash == hash) {
+            if (quadtreesEqual(entry->value, quadtree)) {
+                found = entry->value;
+                break;
+            }
+            table->collisions++;
         }
 
-        index = (index + 1) % table->capacity;
+        index = (index + 1) & mask;
+    }
+
+    table->probes += probes;
+    if (probes > table->longestProbe) {
+        table->longestProbe = probes;
     }
+    return found;
+}
+
+void initLeafTable(LeafTable *table) {
+    table->count = 0;
+    table->capacity = 0;
+    table->leaves = NULL;
+    table->slotCapacity = 0;
+    table->slots = NULL;
+}
+
+void freeLeafTable(LeafTable *table) {
+    FREE_ARRAY(Leaf, table->leaves, table->capacity);
+    FREE_ARRAY(uint32_t, table->slots, table->slotCapacity);
+    initLeafTable(table);
+}
+
+// Returns the slot for `hash` that holds `value`, or the empty slot it should go in.
+static uint32_t *findLeafSlot(const LeafTable *table, uint32_t *slots, int slotCapacity, QuadrantValue value,
+                              uint64_t hash) {
+    uint64_t mask = (uint64_t)slotCapacity - 1;
+    uint64_t index = hash & mask;
+    for (;;) {
+        uint32_t *slot = &slots[index];
+        if (*slot == 0) {
+            return slot;
+        }
+        const Leaf *leaf = &table->leaves[*slot - 1];
+        if (leaf->hash == hash && quadrantValuesEqual(leaf->value, value)) {
+            return slot;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+static void adjustLeafSlots(LeafTable *table, int slotCapacity) {
+    uint32_t *slots = ALLOCATE(uint32_t, slotCapacity);
+    for (int i = 0; i < slotCapacity; i++) {
+        slots[i] = 0;
+    }
+    for (int i = 0; i < table->count; i++) {
+        *findLeafSlot(table, slots, slotCapacity, table->leaves[i].value, table->leaves[i].hash) = i + 1;
+    }
+
+    FREE_ARRAY(uint32_t, table->slots, table->slotCapacity);
+    table->slots = slots;
+    table->slotCapacity = slotCapacity;
+}
+
+// Returns the index of `value` in the table, adding it if it is not there yet.
+uint32_t leafTableIntern(LeafTable *table, QuadrantValue value, uint64_t hash) {
+    if (table->count + 1 > table->slotCapacity * TABLE_MAX_LOAD) {
+        adjustLeafSlots(table, GROW_CAPACITY(table->slotCapacity));
+    }
+
+    uint32_t *slot = findLeafSlot(table, table->slots, table->slotCapacity, value, hash);
+    if (*slot != 0) {
+        return *slot - 1;
+    }
+
+    if (table->count + 1 > table->capacity) {
+        int oldCapacity = table->capacity;
+        table->capacity = GROW_CAPACITY(oldCapacity);
+        table->leaves = GROW_ARRAY(Leaf, table->leaves, oldCapacity, table->capacity);
+    }
+    table->leaves[table->count] = (Leaf){.hash = hash, .value = value};
+    *slot = ++table->count;
+    return *slot - 1;
 }
 
 void tablePrint(Table *table) {
@@ -123,18 +249,13 @@ void tablePrint(Table *table) {
 
     for (int i = 0; i < table->capacity; i++) {
         Entry *entry = &table->entries[i];
-        if (entry->key != -1) {
-            if (IS_QUADTREE(entry->value->NW)) {
-                LogMessage(LOG_INFO, "%03d: key: %10lu : %p = [ NW: %p | NE: %p | SW : %p | SE : %p ]", i, entry->key,
-                           entry->value, AS_QUADTREE(entry->value->NW), AS_QUADTREE(entry->value->NE),
-                           AS_QUADTREE(entry->value->SW), AS_QUADTREE(entry->value->SE));
-            } else {
-                LogMessage(LOG_INFO,
-                           "%03d: key: %10lu : %p = [ NW: %.2d             | NE: %.2d             | SW : %.2d             | "
-                           "SE : %.2d             ]",
-                           i, entry->key, entry->value, AS_INT(entry->value->NW), AS_INT(entry->value->NE),
-                           AS_INT(entry->value->SW), AS_INT(entry->value->SE));
-            }
+        if (entry->value != NULL) {
+            // Quadrants of trees of depth 1 are leaf indices rather than trees
+            QuadTree *quadtree = entry->value;
+            LogMessage(LOG_INFO, "%03d: hash: %20llu : %p (depth %d) = [ %s NW: %u | NE: %u | SW : %u | SE : %u ]", i,
+                       (unsigned long long)entry->hash, quadtree, quadtree->depth,
+                       quadtree->depth == 1 ? "leaves" : "trees", quadtree->NW, quadtree->NE, quadtree->SW,
+                       quadtree->SE);
         }
     }
     LogMessage(LOG_INFO, "===== [  TABLE END  ] - [ Capacity : %d | Count : %d ] =====", table->capacity, table->count);
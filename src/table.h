@@ -1,5 +1,3 @@
-// TODO: Implement tombstones
-
 #ifndef ptest_table_h
 #define ptest_table_h
 
@@ -8,25 +6,61 @@
 
 #define TABLE_MAX_LOAD 0.75
 
+// A slot of the table. Empty slots have no value and a hash of 0, and slots whose tree was deleted have no value and a
+// hash of `TABLE_TOMBSTONE` so probing carries on past them.
 typedef struct Entry {
-    uint32_t key;
+    uint64_t hash;
     QuadTree *value;
-    QuadTree *result;
 } Entry;
 
+#define TABLE_TOMBSTONE 1
+
+// The table interned quadtrees are found in, by the hash of their quadrants. Trees with the same hash each have their
+// own slot, and lookups compare the quadrants of the trees in the slots for the hash. The capacity is always a power of
+// two.
 typedef struct Table {
-    int count;
+    int count; // Slots in use, including tombstones.
     int capacity;
     Entry *entries;
+
+    // Counts of lookups, for checking how well trees are hashed.
+    unsigned long lookups;
+    unsigned long probes;     // Slots passed over before the lookup ended.
+    unsigned long collisions; // Trees passed over with the same hash as the one looked up.
+    unsigned long longestProbe;
 } Table;
 
+// A leaf value with its hash.
+typedef struct Leaf {
+    uint64_t hash;
+    QuadrantValue value;
+} Leaf;
+
+// The table leaf values are interned in. Every distinct value is kept once in `leaves`, and trees of depth 1 name their
+// quadrants by the index of the value there. `slots` finds the index of a value from its hash, holding one more than
+// the index, or 0 where the slot is empty. Leaves are never deleted.
+typedef struct LeafTable {
+    int count;
+    int capacity;
+    Leaf *leaves;
+
+    int slotCapacity; // Always a power of two.
+    uint32_t *slots;
+} LeafTable;
+
 void initTable(Table *table);
 void freeTable(Table *table);
-bool tableGet(Table *table, uint32_t key, QuadTree *out);
-bool tableSet(Table *table, uint32_t key, QuadTree *value);
+bool tableSet(Table *table, uint64_t hash, QuadTree *value);
+bool tableDelete(Table *table, uint64_t hash, const QuadTree *value);
+void tableCompact(Table *table);
 void tableAddAll(Table *from, Table *to);
-QuadTree *tableFindQuadTree(Table *table, const QuadTree *quadtree, uint32_t hash);
+QuadTree *tableFindQuadTree(Table *table, const QuadTree *quadtree, uint64_t hash);
+
+void initLeafTable(LeafTable *table);
+void freeLeafTable(LeafTable *table);
+uint32_t leafTableIntern(LeafTable *table, QuadrantValue value, uint64_t hash);
 
+void tableResetStats(Table *table);
 void tablePrint(Table *table);
 
 #endif // !ptest_table_h
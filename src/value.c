@@ -1,6 +1,7 @@
 #include "value.h"
 #include "cell.h"
 #include "draw.h"
+#include "material.h"
 #include <raylib.h>
 
 void initOccupationNumber(OccupationNumber *occ) {
@@ -16,11 +17,9 @@ void initOccupationNumber(OccupationNumber *occ) {
 }
 
 void initCellValue(CellValue *cvalue, CType type, CMaterial material, int state) {
-    cvalue->type = type;
-    cvalue->material = material;
+    cvalue->kind = CELL_KIND(type, material);
+    cvalue->flags = 0;
     cvalue->state = state;
-    initOccupationNumber(&cvalue->occ);
-    cvalue->settled = false;
 }
 
 CellValue newCellValue(CType type, CMaterial material, int state) {
@@ -30,43 +29,40 @@ CellValue newCellValue(CType type, CMaterial material, int state) {
 }
 
 Color cellColor(CellValue cvalue) {
-    float brightness = 0.5f - cvalue.state / 64.0f;
-    switch (cvalue.material) {
-    case WATER:
-        return ColorBrightness(BLUE, brightness);
-    case LAVA:
-        return ColorBrightness(RED, brightness);
-    case STONE:
-        return ColorBrightness(GRAY, brightness);
-    default:
+    // Empty space and gases have no colour of their own
+    if (CELL_TYPE(cvalue) == VACUUM || CELL_TYPE(cvalue) == GAS) {
         return DARKGRAY;
     }
+
+    float brightness = 0.5f - cvalue.state / 64.0f;
+    return ColorBrightness(getMaterials()->colors[CELL_MATERIAL(cvalue)], brightness);
 }
 
 void drawCellValue(CellValue cvalue, int x, int y, int width, int height) {
+    // Gases are not drawn, leaving the background showing through
+    if (CELL_TYPE(cvalue) == GAS) {
+        return;
+    }
+
     Vector2 pos = (Vector2){x, y};
-    if (cvalue.material == STONE) {
-        DrawRectangle(x, y, width, width, GRAY);
-    } else if (cvalue.material == WATER) {
-        Color color = ColorBrightness(BLUE, 0.5f - cvalue.state / 64.0f);
-        DrawRectangle(x, y, width, width, color);
+    Color color = getMaterials()->colors[CELL_MATERIAL(cvalue)];
+    if (isFluid(cvalue)) {
+        DrawRectangle(x, y, width, width, ColorBrightness(color, 0.5f - cvalue.state / 64.0f));
 #ifdef DEBUG_CELL_INFO
         DrawText(TextFormat("%d", cvalue.state), x, y, 16, WHITE);
 #endif
-    } else if (cvalue.material == LAVA) {
-        Color color = ColorBrightness(ORANGE, 0.5f - cvalue.state / 64.0f);
+    } else if (CELL_TYPE(cvalue) != VACUUM) {
         DrawRectangle(x, y, width, width, color);
     }
 
-    if (cvalue.type == VACUUM) {
+    if (CELL_TYPE(cvalue) == VACUUM) {
         DrawRectangle(x, y, width, width, DARKGRAY);
         DrawRectangle(x, y, width / 2, width / 2, ColorBrightness(DARKGRAY, 0.1));
     }
 }
 
 void copyCellValue(const CellValue *source, CellValue *destination) {
-    destination->type = source->type;
-    destination->material = source->material;
+    destination->kind = source->kind;
     destination->state = source->state;
 }
 
@@ -76,8 +72,8 @@ void setCellState(CellValue *cvalue, int state) {
     }
 }
 
-bool isEmpty(CellValue cvalue) { return cvalue.type == VACUUM; }
+bool isEmpty(CellValue cvalue) { return CELL_TYPE(cvalue) == VACUUM; }
 
-bool isFluid(CellValue cvalue) { return cvalue.type == FLUID; }
+bool isFluid(CellValue cvalue) { return CELL_TYPE(cvalue) == FLUID; }
 
 int difference(CellValue left, CellValue right) { return left.state - right.state; }
@@ -3,17 +3,17 @@
 
 #include "common.h"
 
-// For calculating cell spread
+// For calculating cell spread. Each component is bounded by the state of the cell it came from.
 typedef struct OccupationNumber {
-    int nw;
-    int n;
-    int ne;
-    int w;
-    int c;
-    int e;
-    int sw;
-    int s;
-    int se;
+    int16_t nw;
+    int16_t n;
+    int16_t ne;
+    int16_t w;
+    int16_t c;
+    int16_t e;
+    int16_t sw;
+    int16_t s;
+    int16_t se;
 } OccupationNumber;
 
 typedef enum {
@@ -31,14 +31,34 @@ typedef enum {
     STONE,
 } CMaterial;
 
+// A set of materials, a bit for each. There is room for every material `kind` can hold.
+typedef uint16_t MaterialSet;
+
+#define MATERIAL_BIT(material) ((MaterialSet)(1u << (material)))
+#define ALL_MATERIALS ((MaterialSet)0xFFFF)
+
+// A cell packed into 4 bytes. The type and material share the `kind` byte, and should be read through `CELL_TYPE` and
+// `CELL_MATERIAL`. Occupation numbers are transient, so they are not stored in the cell (see grid.c).
 typedef struct CellValue {
-    CType type;
-    CMaterial material;
-    int state;
-    OccupationNumber occ;
-    bool settled;
+    uint8_t kind;
+    uint8_t flags;
+    uint16_t state;
 } CellValue;
 
+#define CELL_TYPE_SHIFT 4
+#define CELL_MATERIAL_MASK 0x0F
+
+#define CELL_KIND(type, material) ((uint8_t)(((type) << CELL_TYPE_SHIFT) | (material)))
+#define CELL_TYPE(cvalue) ((CType)((cvalue).kind >> CELL_TYPE_SHIFT))
+#define CELL_MATERIAL(cvalue) ((CMaterial)((cvalue).kind & CELL_MATERIAL_MASK))
+
+// Set on a cell once it has been drawn, and cleared whenever it may have changed.
+#define CELL_SETTLED 0x01
+
+#define IS_SETTLED(cvalue) (((cvalue).flags & CELL_SETTLED) != 0)
+#define SETTLE(cvalue) ((cvalue).flags |= CELL_SETTLED)
+#define UNSETTLE(cvalue) ((cvalue).flags &= (uint8_t)~CELL_SETTLED)
+
 void initOccupationNumber(OccupationNumber *occ);
 void initCellValue(CellValue *cvalue, CType type, CMaterial material, int state);
 CellValue newCellValue(CType type, CMaterial material, int state);
@@ -0,0 +1,160 @@
+#include "workers.h"
+#include "debug.h"
+#include "memory.h"
+
+#include <pthread.h>
+#include <raylib.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// A fixed pool of threads which all run the same task, with the calling thread acting as worker 0. `runWorkers`
+// returns once every worker has finished, so consecutive calls are separated by a barrier.
+typedef struct WorkerPool {
+    pthread_t *threads;
+    int count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+
+    WorkerTask task;
+    void *data;
+    unsigned long generation; // Incremented for every task handed out.
+    int running;              // Workers still busy with the current task.
+    bool quit;
+} WorkerPool;
+
+typedef struct WorkerArgs {
+    WorkerPool *pool;
+    int worker;
+} WorkerArgs;
+
+static WorkerPool pool = {.count = 1};
+static WorkerArgs *args = NULL;
+
+static void *workerMain(void *arg) {
+    WorkerArgs *self = (WorkerArgs *)arg;
+    WorkerPool *p = self->pool;
+    unsigned long seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        while (p->generation == seen && !p->quit) {
+            pthread_cond_wait(&p->start, &p->lock);
+        }
+        if (p->quit) {
+            pthread_mutex_unlock(&p->lock);
+            return NULL;
+        }
+        seen = p->generation;
+        WorkerTask task = p->task;
+        void *data = p->data;
+        pthread_mutex_unlock(&p->lock);
+
+        task(self->worker, p->count, data);
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->running == 0) {
+            pthread_cond_signal(&p->done);
+        }
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+// Starts `count` workers, including the calling thread. A count of 1 runs every task serially.
+void initWorkers(int count) {
+    freeWorkers();
+    if (count < 1) {
+        count = 1;
+    }
+
+    pool.count = count;
+    pool.generation = 0;
+    pool.running = 0;
+    pool.quit = false;
+    if (count == 1) {
+        return;
+    }
+
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.start, NULL);
+    pthread_cond_init(&pool.done, NULL);
+
+    pool.threads = ALLOCATE(pthread_t, count - 1);
+    args = ALLOCATE(WorkerArgs, count - 1);
+    for (int i = 0; i < count - 1; i++) {
+        args[i] = (WorkerArgs){&pool, i + 1};
+        if (pthread_create(&pool.threads[i], NULL, workerMain, &args[i]) != 0) {
+            LogMessage(LOG_ERROR, "Failed to start worker %d, continuing with %d workers", i + 1, i + 1);
+            pool.count = i + 1;
+            break;
+        }
+    }
+}
+
+void freeWorkers() {
+    if (pool.threads == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.quit = true;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (int i = 0; i < pool.count - 1; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+
+    FREE(pthread_t, pool.threads);
+    FREE(WorkerArgs, args);
+    pool.threads = NULL;
+    args = NULL;
+
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.start);
+    pthread_cond_destroy(&pool.done);
+
+    pool.count = 1;
+}
+
+int workerCount() { return pool.count; }
+
+// Returns the number of processors available, or 1 if it cannot be determined.
+int processorCount() {
+#ifdef _WIN32
+    // Avoid windows.h, which clashes with raylib
+    const char *processors = getenv("NUMBER_OF_PROCESSORS");
+    int count = processors != NULL ? atoi(processors) : 1;
+#else
+    int count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? count : 1;
+}
+
+// Runs `task` on every worker and waits for all of them to finish.
+void runWorkers(WorkerTask task, void *data) {
+    if (pool.count == 1) {
+        task(0, 1, data);
+        return;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.task = task;
+    pool.data = data;
+    pool.running = pool.count - 1;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.lock);
+
+    task(0, pool.count, data);
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.running > 0) {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
@@ -0,0 +1,16 @@
+#ifndef ptest_workers_h
+#define ptest_workers_h
+
+#include <stdbool.h>
+
+// A task run by every worker in the pool. `worker` is in [0, workers).
+typedef void (*WorkerTask)(int worker, int workers, void *data);
+
+void initWorkers(int count);
+void freeWorkers();
+int workerCount();
+int processorCount();
+
+void runWorkers(WorkerTask task, void *data);
+
+#endif // ptest_workers_h
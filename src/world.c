@@ -0,0 +1,523 @@
+#include "world.h"
+#include "common.h"
+#include "debug.h"
+#include "grid.h"
+#include "hash.h"
+#include "memory.h"
+#include "workers.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Fluid can change cells up to this far away in a step, so a chunk is needed once fluid in a neighbour is this close.
+#define WORLD_REACH 2
+
+#define CHUNK_CELLS (WORLD_CHUNK_SIZE * WORLD_CHUNK_SIZE)
+
+static const CellValue vacuum = {CELL_KIND(VACUUM, NONE), 0, 0};
+
+// The chunks being evolved this step, see `evolveWorld`.
+static WorldChunk **stepChunks = NULL;
+static int stepChunksCount = 0;
+static int stepChunksCapacity = 0;
+
+// Resident chunks sorted by when they were last used, see `trimWorld`.
+static WorldChunk **evictChunks = NULL;
+static int evictChunksCapacity = 0;
+
+// Rounds `value / size` towards negative infinity, so negative cells land in negative chunks.
+static int floorDiv(int value, int size) { return (value >= 0 ? value : value - size + 1) / size; }
+
+// Coordinates are hashed as unsigned, as the hash shifts its key left.
+static uint32_t chunkHash(int x, int y) {
+    return (uint32_t)hash_6432shift((uint32_t)x) * 31 + (uint32_t)hash_6432shift((uint32_t)y);
+}
+
+void initWorld(World *world) {
+    world->count = 0;
+    world->capacity = 0;
+    world->chunks = NULL;
+    world->paged = false;
+    world->resident = 0;
+    world->residentLimit = 0;
+    world->step = 0;
+}
+
+// Maps a paged out chunk back in, and marks it used this step.
+static void pageIn(World *world, WorldChunk *chunk) {
+    chunk->used = world->step;
+    if (chunk->cells != NULL) {
+        return;
+    }
+
+    CellValue *map = (CellValue *)mapSlot(&world->store, chunk->slot);
+    chunk->cells = chunk->flipped ? map + CHUNK_CELLS : map;
+    chunk->next = chunk->flipped ? map : map + CHUNK_CELLS;
+    world->resident++;
+}
+
+static void pageOut(World *world, WorldChunk *chunk) {
+    if (chunk->cells == NULL) {
+        return;
+    }
+
+    unmapSlot(&world->store, chunk->flipped ? chunk->next : chunk->cells);
+    chunk->cells = NULL;
+    chunk->next = NULL;
+    world->resident--;
+}
+
+static void freeChunk(World *world, WorldChunk *chunk) {
+    if (chunk->slot >= 0) {
+        pageOut(world, chunk);
+        releaseSlot(&world->store, chunk->slot);
+    } else {
+        FREE_ARRAY(CellValue, chunk->cells, CHUNK_CELLS);
+        FREE_ARRAY(CellValue, chunk->next, CHUNK_CELLS);
+    }
+    FREE(WorldChunk, chunk);
+}
+
+void freeWorld(World *world) {
+    for (int i = 0; i < world->capacity; i++) {
+        if (world->chunks[i] != NULL) {
+            freeChunk(world, world->chunks[i]);
+        }
+    }
+    FREE_ARRAY(WorldChunk *, world->chunks, world->capacity);
+    if (world->paged) {
+        closeStore(&world->store);
+    }
+    initWorld(world);
+}
+
+// Moves the chunks of `world` into a store backed by a file at `path`, keeping at most `residentLimit` of them mapped
+// between steps. Returns `false`, leaving the world in memory, if the store cannot be opened.
+bool pageWorld(World *world, const char *path, int residentLimit) {
+    if (world->paged) {
+        world->residentLimit = residentLimit;
+        return true;
+    }
+
+    // A slot holds both buffers of a chunk, so swapping them after a step stays inside the mapping
+    if (!openStore(&world->store, path, sizeof(CellValue) * CHUNK_CELLS * 2)) {
+        return false;
+    }
+    world->paged = true;
+    world->residentLimit = residentLimit;
+
+    for (int i = 0; i < world->capacity; i++) {
+        WorldChunk *chunk = world->chunks[i];
+        if (chunk == NULL) {
+            continue;
+        }
+
+        CellValue *cells = chunk->cells;
+        CellValue *next = chunk->next;
+        chunk->slot = reserveSlot(&world->store);
+        chunk->cells = NULL;
+        chunk->flipped = false;
+        pageIn(world, chunk);
+        memcpy(chunk->cells, cells, sizeof(CellValue) * CHUNK_CELLS);
+        FREE_ARRAY(CellValue, cells, CHUNK_CELLS);
+        FREE_ARRAY(CellValue, next, CHUNK_CELLS);
+    }
+    return true;
+}
+
+// Returns the slot chunk `x`, `y` is in, or the empty slot it would go in.
+static WorldChunk **findSlot(WorldChunk **chunks, int capacity, int x, int y) {
+    uint32_t index = chunkHash(x, y) % capacity;
+
+    for (;;) {
+        WorldChunk **slot = &chunks[index];
+        if (*slot == NULL || ((*slot)->x == x && (*slot)->y == y)) {
+            return slot;
+        }
+
+        index = (index + 1) % capacity;
+    }
+}
+
+static WorldChunk *findChunk(const World *world, int x, int y) {
+    if (world->count == 0) {
+        return NULL;
+    }
+    return *findSlot(world->chunks, world->capacity, x, y);
+}
+
+static void adjustCapacity(World *world, int capacity) {
+    WorldChunk **chunks = ALLOCATE(WorldChunk *, capacity);
+    for (int i = 0; i < capacity; i++) {
+        chunks[i] = NULL;
+    }
+
+    for (int i = 0; i < world->capacity; i++) {
+        WorldChunk *chunk = world->chunks[i];
+        if (chunk != NULL) {
+            *findSlot(chunks, capacity, chunk->x, chunk->y) = chunk;
+        }
+    }
+
+    FREE_ARRAY(WorldChunk *, world->chunks, world->capacity);
+    world->chunks = chunks;
+    world->capacity = capacity;
+}
+
+// Returns chunk `x`, `y`, allocating it full of vacuum if it does not exist yet.
+static WorldChunk *addChunk(World *world, int x, int y) {
+    if (world->count + 1 > world->capacity * WORLD_MAX_LOAD) {
+        adjustCapacity(world, GROW_CAPACITY(world->capacity));
+    }
+
+    WorldChunk **slot = findSlot(world->chunks, world->capacity, x, y);
+    if (*slot != NULL) {
+        return *slot;
+    }
+
+    WorldChunk *chunk = ALLOCATE(WorldChunk, 1);
+    chunk->x = x;
+    chunk->y = y;
+    chunk->flipped = false;
+    if (world->paged) {
+        chunk->slot = reserveSlot(&world->store);
+        chunk->cells = NULL;
+        pageIn(world, chunk);
+    } else {
+        chunk->slot = -1;
+        chunk->cells = ALLOCATE(CellValue, CHUNK_CELLS);
+        chunk->next = ALLOCATE(CellValue, CHUNK_CELLS);
+    }
+    for (int i = 0; i < CHUNK_CELLS; i++) {
+        chunk->cells[i] = vacuum;
+    }
+    chunk->used = world->step;
+    chunk->changed = false;
+    chunk->awake = false;
+    chunk->needed = false;
+
+    *slot = chunk;
+    world->count++;
+    return chunk;
+}
+
+static void removeChunk(World *world, WorldChunk *chunk) {
+    WorldChunk **slot = findSlot(world->chunks, world->capacity, chunk->x, chunk->y);
+    *slot = NULL;
+    world->count--;
+    freeChunk(world, chunk);
+
+    // Put back the chunks after the gap, so lookups which probed past it still find them
+    int index = (int)(slot - world->chunks);
+    for (index = (index + 1) % world->capacity; world->chunks[index] != NULL; index = (index + 1) % world->capacity) {
+        WorldChunk *moved = world->chunks[index];
+        world->chunks[index] = NULL;
+        *findSlot(world->chunks, world->capacity, moved->x, moved->y) = moved;
+    }
+}
+
+// Returns the cell at `row`, `col`. Paged out chunks are read from the store without being mapped back in.
+CellValue getWorldCell(const World *world, int row, int col) {
+    int x = floorDiv(col, WORLD_CHUNK_SIZE);
+    int y = floorDiv(row, WORLD_CHUNK_SIZE);
+    WorldChunk *chunk = findChunk(world, x, y);
+    if (chunk == NULL) {
+        return vacuum;
+    }
+
+    int index = (row - y * WORLD_CHUNK_SIZE) * WORLD_CHUNK_SIZE + (col - x * WORLD_CHUNK_SIZE);
+    if (chunk->cells != NULL) {
+        return chunk->cells[index];
+    }
+
+    CellValue cell = vacuum;
+    size_t offset = sizeof(CellValue) * ((chunk->flipped ? CHUNK_CELLS : 0) + index);
+    if (!readSlot(&world->store, chunk->slot, offset, &cell, sizeof(CellValue))) {
+        LogMessage(LOG_ERROR, "Failed to read chunk (%d, %d) from the store", x, y);
+    }
+    return cell;
+}
+
+void setWorldCell(World *world, int row, int col, CellValue value) {
+    int x = floorDiv(col, WORLD_CHUNK_SIZE);
+    int y = floorDiv(row, WORLD_CHUNK_SIZE);
+    WorldChunk *chunk = findChunk(world, x, y);
+    if (chunk == NULL) {
+        if (CELL_TYPE(value) == VACUUM) {
+            return;
+        }
+        chunk = addChunk(world, x, y);
+    }
+    if (world->paged) {
+        pageIn(world, chunk);
+    }
+
+    UNSETTLE(value);
+    chunk->cells[(row - y * WORLD_CHUNK_SIZE) * WORLD_CHUNK_SIZE + (col - x * WORLD_CHUNK_SIZE)] = value;
+    chunk->changed = true;
+}
+
+// Reads cells of the world for `advanceBlock`. Cells in chunks that do not exist are vacuum. Every chunk read must be
+// paged in, see `evolveWorld`.
+static void readWorldCells(const void *source, int row, int col, int count, CellValue *cells) {
+    const World *world = (const World *)source;
+    int y = floorDiv(row, WORLD_CHUNK_SIZE);
+    int chunkRow = row - y * WORLD_CHUNK_SIZE;
+
+    while (count > 0) {
+        int x = floorDiv(col, WORLD_CHUNK_SIZE);
+        int chunkCol = col - x * WORLD_CHUNK_SIZE;
+        int span = WORLD_CHUNK_SIZE - chunkCol < count ? WORLD_CHUNK_SIZE - chunkCol : count;
+
+        WorldChunk *chunk = findChunk(world, x, y);
+        if (chunk != NULL) {
+            memcpy(cells, &chunk->cells[chunkRow * WORLD_CHUNK_SIZE + chunkCol], sizeof(CellValue) * span);
+        } else {
+            for (int i = 0; i < span; i++) {
+                cells[i] = vacuum;
+            }
+        }
+
+        cells += span;
+        col += span;
+        count -= span;
+    }
+}
+
+// Returns `true` if any cell of `chunk` in rows [rowStart, rowEnd) and cols [colStart, colEnd) is a fluid.
+static bool fluidIn(const WorldChunk *chunk, int rowStart, int rowEnd, int colStart, int colEnd) {
+    for (int row = rowStart; row < rowEnd; row++) {
+        for (int col = colStart; col < colEnd; col++) {
+            if (isFluid(chunk->cells[row * WORLD_CHUNK_SIZE + col])) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool chunkEmpty(const WorldChunk *chunk) {
+    for (int i = 0; i < CHUNK_CELLS; i++) {
+        if (CELL_TYPE(chunk->cells[i]) != VACUUM) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void addStepChunk(WorldChunk *chunk) {
+    if (stepChunksCount == stepChunksCapacity) {
+        int capacity = GROW_CAPACITY(stepChunksCapacity);
+        stepChunks = GROW_ARRAY(WorldChunk *, stepChunks, stepChunksCapacity, capacity);
+        stepChunksCapacity = capacity;
+    }
+
+    stepChunks[stepChunksCount++] = chunk;
+}
+
+// Wakes every chunk that changed, along with its neighbours, and lists them in `stepChunks`. The rest are left as
+// they are, as a chunk whose neighbourhood did not change would step to what it already is.
+static void wakeChunks(World *world) {
+    for (int i = 0; i < world->capacity; i++) {
+        if (world->chunks[i] != NULL) {
+            world->chunks[i]->awake = false;
+            world->chunks[i]->needed = false;
+        }
+    }
+
+    stepChunksCount = 0;
+    for (int i = 0; i < world->capacity; i++) {
+        WorldChunk *chunk = world->chunks[i];
+        if (chunk == NULL || !chunk->changed) {
+            continue;
+        }
+
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                WorldChunk *neighbour = findChunk(world, chunk->x + dx, chunk->y + dy);
+                if (neighbour != NULL && !neighbour->awake) {
+                    neighbour->awake = true;
+                    addStepChunk(neighbour);
+                }
+            }
+        }
+    }
+}
+
+// Allocates the chunks that fluid in an awake chunk could flow into this step, and marks them as needed so they are
+// not freed while the fluid is still close. New chunks are woken too.
+static void growWorld(World *world) {
+    int count = stepChunksCount;
+    int near = WORLD_REACH;
+    int far = WORLD_CHUNK_SIZE - WORLD_REACH;
+    for (int i = 0; i < count; i++) {
+        WorldChunk *chunk = stepChunks[i];
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                if (dx == 0 && dy == 0) {
+                    continue;
+                }
+
+                // The edge or corner of this chunk facing the neighbour
+                int rowStart = dy > 0 ? far : 0;
+                int rowEnd = dy < 0 ? near : WORLD_CHUNK_SIZE;
+                int colStart = dx > 0 ? far : 0;
+                int colEnd = dx < 0 ? near : WORLD_CHUNK_SIZE;
+                if (!fluidIn(chunk, rowStart, rowEnd, colStart, colEnd)) {
+                    continue;
+                }
+
+                WorldChunk *neighbour = addChunk(world, chunk->x + dx, chunk->y + dy);
+                neighbour->needed = true;
+                if (!neighbour->awake) {
+                    neighbour->awake = true;
+                    addStepChunk(neighbour);
+                }
+            }
+        }
+    }
+}
+
+// Pages in the neighbours awake chunks read from, and asks the store to read ahead the ring of chunks around them, as
+// they are the ones the active region spreads into next.
+static void pageNeighbours(World *world) {
+    for (int i = 0; i < stepChunksCount; i++) {
+        WorldChunk *chunk = stepChunks[i];
+        for (int dy = -2; dy <= 2; dy++) {
+            for (int dx = -2; dx <= 2; dx++) {
+                WorldChunk *neighbour = findChunk(world, chunk->x + dx, chunk->y + dy);
+                if (neighbour == NULL) {
+                    continue;
+                }
+
+                if (abs(dx) <= 1 && abs(dy) <= 1) {
+                    pageIn(world, neighbour);
+                } else if (neighbour->cells == NULL) {
+                    prefetchSlot(&world->store, neighbour->slot);
+                }
+            }
+        }
+    }
+}
+
+static int compareUsed(const void *a, const void *b) {
+    unsigned long usedA = (*(WorldChunk *const *)a)->used;
+    unsigned long usedB = (*(WorldChunk *const *)b)->used;
+    return (usedA > usedB) - (usedA < usedB);
+}
+
+// Pages out the least recently used chunks until no more than the resident limit are mapped. Chunks used this step
+// are kept even if that leaves the world over the limit.
+static void trimWorld(World *world) {
+    if (!world->paged || world->resident <= world->residentLimit) {
+        return;
+    }
+
+    if (world->resident > evictChunksCapacity) {
+        evictChunks = GROW_ARRAY(WorldChunk *, evictChunks, evictChunksCapacity, world->capacity);
+        evictChunksCapacity = world->capacity;
+    }
+
+    int count = 0;
+    for (int i = 0; i < world->capacity; i++) {
+        WorldChunk *chunk = world->chunks[i];
+        if (chunk != NULL && chunk->cells != NULL && chunk->used < world->step) {
+            evictChunks[count++] = chunk;
+        }
+    }
+    qsort(evictChunks, count, sizeof(WorldChunk *), compareUsed);
+
+    for (int i = 0; i < count && world->resident > world->residentLimit; i++) {
+        pageOut(world, evictChunks[i]);
+    }
+}
+
+// Advances the chunks given to this worker a step. Every chunk reads the world as it was before the step, and writes
+// its own `next`, so the chunks are independent of each other.
+static void evolveWorldChunks(int worker, int workers, void *data) {
+    const World *world = (const World *)data;
+    CellSource source = {readWorldCells, world, INT_MIN / 2, INT_MAX / 2, INT_MIN / 2, INT_MAX / 2};
+
+    int start = stepChunksCount * worker / workers;
+    int end = stepChunksCount * (worker + 1) / workers;
+    for (int i = start; i < end; i++) {
+        WorldChunk *chunk = stepChunks[i];
+        BlockResult block = advanceBlock(source, chunk->y * WORLD_CHUNK_SIZE, chunk->x * WORLD_CHUNK_SIZE,
+                                         WORLD_CHUNK_SIZE, WORLD_CHUNK_SIZE, 1, worker, chunk->next, WORLD_CHUNK_SIZE);
+        chunk->changed = block == BLOCK_CHANGED;
+    }
+}
+
+// Evolves `world` one step, using the same rules as a grid. Only chunks near a change are evolved. Chunks are
+// allocated before the step wherever fluid could flow into them, and freed after it once they are empty, unchanged,
+// and no fluid is close.
+void evolveWorld(World *world) {
+    world->step++;
+
+    wakeChunks(world);
+    if (world->paged) {
+        for (int i = 0; i < stepChunksCount; i++) {
+            pageIn(world, stepChunks[i]);
+        }
+    }
+    growWorld(world);
+    if (world->paged) {
+        pageNeighbours(world);
+    }
+
+    prepareBlocks(WORLD_CHUNK_SIZE, WORLD_CHUNK_SIZE, 1);
+    runWorkers(evolveWorldChunks, world);
+
+    for (int i = 0; i < stepChunksCount; i++) {
+        WorldChunk *chunk = stepChunks[i];
+        if (chunk->changed) {
+            CellValue *temp = chunk->cells;
+            chunk->cells = chunk->next;
+            chunk->next = temp;
+            chunk->flipped = !chunk->flipped;
+        }
+    }
+
+    // A chunk that changed has to stay a step longer, to wake its neighbours
+    for (int i = 0; i < stepChunksCount; i++) {
+        WorldChunk *chunk = stepChunks[i];
+        if (!chunk->needed && !chunk->changed && chunkEmpty(chunk)) {
+            removeChunk(world, chunk);
+        }
+    }
+
+    trimWorld(world);
+}
+
+// Draws the cells of every chunk overlapping `view`, one unit to a cell. Vacuum is left undrawn. Paged out chunks in
+// view are paged back in.
+void drawWorld(World *world, Rectangle view) {
+    for (int i = 0; i < world->capacity; i++) {
+        WorldChunk *chunk = world->chunks[i];
+        if (chunk == NULL) {
+            continue;
+        }
+
+        int x = chunk->x * WORLD_CHUNK_SIZE;
+        int y = chunk->y * WORLD_CHUNK_SIZE;
+        if (x + WORLD_CHUNK_SIZE < view.x || x > view.x + view.width || y + WORLD_CHUNK_SIZE < view.y ||
+            y > view.y + view.height) {
+            continue;
+        }
+
+        if (world->paged) {
+            pageIn(world, chunk);
+        }
+        for (int row = 0; row < WORLD_CHUNK_SIZE; row++) {
+            for (int col = 0; col < WORLD_CHUNK_SIZE; col++) {
+                CellValue cell = chunk->cells[row * WORLD_CHUNK_SIZE + col];
+                if (CELL_TYPE(cell) != VACUUM) {
+                    DrawRectangle(x + col, y + row, 1, 1, cellColor(cell));
+                }
+            }
+        }
+    }
+
+    trimWorld(world);
+}
@@ -0,0 +1,55 @@
+#ifndef ptest_world_h
+#define ptest_world_h
+
+#include "common.h"
+#include "store.h"
+#include "value.h"
+
+// Number of cells a side of a world chunk.
+#define WORLD_CHUNK_SIZE 64
+
+#define WORLD_MAX_LOAD 0.75
+
+// A square of cells in the world. Chunk `x`, `y` holds the cells in cols [x, x + 1) * WORLD_CHUNK_SIZE and rows
+// [y, y + 1) * WORLD_CHUNK_SIZE. Chunks are allocated as fluid comes near them, and freed once they are empty.
+typedef struct WorldChunk {
+    int x;
+    int y;
+    CellValue *cells;   // Row major, WORLD_CHUNK_SIZE cells to a row. NULL while paged out.
+    CellValue *next;    // Where the next step is written, before being swapped with `cells`.
+    int slot;           // Slot of the world's store holding both buffers, or -1 if they are in memory.
+    bool flipped;       // Set when `cells` is the second buffer of the slot.
+    unsigned long used; // Step the chunk was last evolved, read or drawn in, for evicting the least recently used.
+    bool changed;       // Set when the last step or a paint changed the chunk.
+    bool awake;         // Set when the chunk is evolved this step.
+    bool needed;        // Set when fluid in a neighbouring chunk is close enough to flow in.
+} WorldChunk;
+
+// An unbounded world of cells. Only chunks that are not empty vacuum are stored, in a hash table keyed by their
+// position, so memory follows the area that is occupied rather than the size of the world.
+//
+// With a store, chunks live in a file and are only mapped in while the world is using them. Once more than
+// `residentLimit` are mapped, the least recently used ones are unmapped until the world is back under the limit.
+typedef struct World {
+    int count;
+    int capacity;
+    WorldChunk **chunks;
+
+    bool paged;
+    Store store;
+    int resident;
+    int residentLimit;
+    unsigned long step;
+} World;
+
+void initWorld(World *world);
+void freeWorld(World *world);
+bool pageWorld(World *world, const char *path, int residentLimit);
+
+CellValue getWorldCell(const World *world, int row, int col);
+void setWorldCell(World *world, int row, int col, CellValue value);
+
+void evolveWorld(World *world);
+void drawWorld(World *world, Rectangle view);
+
+#endif // ptest_world_h